@@ -59,15 +59,22 @@
 
 
   ;; Escape all chars that need escaping in XML
+  ;;
+  ;; Most strings contain nothing that needs escaping: These are returned
+  ;; as they are. All others are escaped in one pass.
   (defun wxxml-fix-string (x)
-    (if (stringp x)
-	(let* ((tmp-x (string-substitute "&amp;" #\& x))
-	       (tmp-x (string-substitute "&lt;" #\< tmp-x))
-	       (tmp-x (string-substitute "&gt;" #\> tmp-x))
-	       (tmp-x (string-substitute "&#13;" #\Return tmp-x))
-	       (tmp-x (string-substitute "&#13;" #\Linefeed tmp-x))
-	       (tmp-x (string-substitute "&#13;" #\Newline tmp-x)))
-	  tmp-x)
+    (if (and (stringp x)
+	     (find-if #'(lambda (c)
+			  (member c '(#\& #\< #\> #\Return #\Linefeed #\Newline)))
+		      x))
+	(with-output-to-string (out)
+	  (loop for c across x do
+		(cond ((char= c #\&) (write-string "&amp;" out))
+		      ((char= c #\<) (write-string "&lt;" out))
+		      ((char= c #\>) (write-string "&gt;" out))
+		      ((member c '(#\Return #\Linefeed #\Newline))
+		       (write-string "&#13;" out))
+		      (t (write-char c out)))))
       x))
 
   ;; Allow the user to communicate what to display in the statusbar whilst
@@ -197,10 +204,13 @@
     (unless (symbolp x)
       (return-from subscriptp x))
     (let* ((name (subseq (maybe-invert-string-case (symbol-name x)) 1))
-	   (pos (search "_" name :from-end t))
-	   #-gcl (*readtable* (copy-readtable nil)))
-      #-gcl (setf (readtable-case *readtable*) :invert)
-      (when pos
+	   (pos (search "_" name :from-end t)))
+      ;; Most symbols don't contain an underscore => Don't copy the readtable
+      ;; for them.
+      (unless pos
+	(return-from subscriptp nil))
+      (let (#-gcl (*readtable* (copy-readtable nil)))
+	#-gcl (setf (readtable-case *readtable*) :invert)
 	(let* ((sub (subseq name (+ pos 1)))
 	       (sub-var (subseq name 0 pos))
 	       (sub-var-symb (read-from-string (concatenate 'string "$" sub-var)))
@@ -225,7 +235,10 @@
 
   (defun wxxmlnumformat (atom)
     (let (r firstpart exponent)
-      (cond ((integerp atom)
+      (cond ((and (integerp atom) (eql *print-base* 10) (not *print-radix*))
+	     ;; The common case: No need to split the number into digits first.
+	     (format nil "<mn>~d</mn>" atom))
+	    ((integerp atom)
 	     (format nil "<mn>~{~c~}</mn>" (exploden atom)))
 	    (t
 	     (setq r (exploden atom))
@@ -243,10 +256,32 @@
 			    "<mrow><mn>~{~c~}</mn><h>*</h><msup><mn>10</mn><mn>~{~c~}</mn></msup></mrow>"
 			    firstpart exponent)))))))
 
-  (defun wxxml-stripdollar (sym &aux pname)
+  ;; The XML wxxml-stripdollar has generated for each symbol, indexed by the
+  ;; opening tag in *var-tag*. Is flushed if $noundisp or $lispdisp change.
+  (defvar *wxxml-symbol-cache* (make-hash-table :test #'eq))
+  (defvar *wxxml-symbol-cache-flags* (cons nil nil))
+
+  (defun wxxml-stripdollar (sym)
     (or (symbolp sym)
 	(return-from wxxml-stripdollar
 		     (wxxml-fix-string (format nil "~a" sym))))
+    (unless (and (eq (car *wxxml-symbol-cache-flags*) $noundisp)
+		 (eq (cdr *wxxml-symbol-cache-flags*) $lispdisp))
+      (clrhash *wxxml-symbol-cache*)
+      (setq *wxxml-symbol-cache-flags* (cons $noundisp $lispdisp)))
+    ;; Don't let symbols that are displayed only once fill up the memory
+    (if (> (hash-table-count *wxxml-symbol-cache*) 10000)
+	(clrhash *wxxml-symbol-cache*))
+    (let* ((entries (gethash sym *wxxml-symbol-cache*))
+	   (entry (assoc (car *var-tag*) entries :test #'equal)))
+      (if entry
+	  (cdr entry)
+	(let ((xml (wxxml-stripdollar-uncached sym)))
+	  (setf (gethash sym *wxxml-symbol-cache*)
+		(acons (car *var-tag*) xml entries))
+	  xml))))
+
+  (defun wxxml-stripdollar-uncached (sym &aux pname)
     (setq pname (maybe-invert-string-case (symbol-name sym)))
     (setq pname (cond ((and (> (length pname) 0)
 			    (member (elt pname 0) '(#\$ #\&) :test #'eq))
@@ -903,17 +938,19 @@
 	     (wxxml (cadr x) l r 'mplus rop)))
 	  (t (setq l (wxxml (cadr x) l nil lop 'mplus)
 		   x (cddr x))
-	     (do ((nl l)  (dissym))
+	     (do ((nl (list l)) (dissym))
 		 ((null (cdr x))
 		  (if (mmminusp (car x)) (setq l (cadar x) dissym
 					       (list "<mi>-</mi>"))
 		    (setq l (car x) dissym (list "<mi>+</mi>")))
 		  (setq r (wxxml l dissym r 'mplus rop))
-		  (append nl r))
+		  ;; Appending each term to all terms before it would make
+		  ;; long sums take quadratic time => join them only here.
+		  (loop for term in (nreverse (cons r nl)) append term))
 		 (if (mmminusp (car x)) (setq l (cadar x) dissym
 					      (list "<mi>-</mi>"))
 		   (setq l (car x) dissym (list "<mi>+</mi>")))
-		 (setq nl (append nl (wxxml l dissym nil 'mplus 'mplus))
+		 (setq nl (cons (wxxml l dissym nil 'mplus 'mplus) nl)
 		       x (cdr x))))))
 
   (defprop mminus wxxml-prefix wxxml)
@@ -1170,12 +1207,107 @@
 
   (defprop spaceout wxxml-spaceout wxxml)
 
+  ;; If true maxima's 2D output is sent in the compact format
+  ;; wx-write-compact generates instead of as XML. Set by wxMaxima.
+  (defvar *wx-compact-output* nil)
+
+  ;; The tags the compact format refers to by their number in this list.
+  ;; Must match the list in MathParser::DecodeCompactXml().
+  (defvar *wx-compact-tags*
+    (let ((ids (make-hash-table :test #'equal)))
+      (loop for tag in '("mth" "lbl" "mrow" "p" "mi" "mn" "mo" "h" "t" "st"
+			 "fn" "fnm" "munder" "msup" "mspace" "f" "q" "s" "g"
+			 "tb" "mtr" "mtd" "ie" "in" "sm" "lm" "at" "d" "a"
+			 "cj" "hl" "mmultiscripts" "mfrac")
+	    for id from 0 do
+	    (setf (gethash tag ids) (format nil "~d" id)))
+      ids))
+
+  ;; Writes the XML fragments wxxml has generated in the compact format:
+  ;;  - An element is written as {tag@attribute=value@attribute=value|contents}
+  ;;    with tag being the tag's number in *wx-compact-tags* or its name.
+  ;;  - In texts and attribute values \ { } | and @ are escaped by a \.
+  ;;    Entities are left as they are.
+  ;; Tags may be split between fragments.
+  (defun wx-write-compact (fragments)
+    (let ((state 'text)
+	  (quote-char #\")
+	  (name (make-array 16 :element-type 'character
+			    :adjustable t :fill-pointer 0)))
+      (flet ((write-escaped (c)
+	       (if (member c '(#\\ #\{ #\} #\| #\@))
+		   (write-char #\\))
+	       (write-char c))
+	     (write-tag ()
+	       (write-char #\{)
+	       (write-string (or (gethash name *wx-compact-tags*) name))))
+	(flet ((feed (c)
+		 (let ((whitespace (member c '(#\Space #\Tab #\Newline #\Return))))
+		   (case state
+		     (text
+		      (if (char= c #\<)
+			  (setq state 'tag-start)
+			(write-escaped c)))
+		     (tag-start
+		      (setf (fill-pointer name) 0)
+		      (if (char= c #\/)
+			  (setq state 'end-tag)
+			(progn
+			  (vector-push-extend c name)
+			  (setq state 'tag-name))))
+		     (tag-name
+		      (cond (whitespace (write-tag) (setq state 'attributes))
+			    ((char= c #\/) (write-tag) (setq state 'empty-tag-end))
+			    ((char= c #\>) (write-tag) (write-char #\|)
+			     (setq state 'text))
+			    (t (vector-push-extend c name))))
+		     (attributes
+		      (cond (whitespace)
+			    ((char= c #\/) (setq state 'empty-tag-end))
+			    ((char= c #\>) (write-char #\|) (setq state 'text))
+			    (t (write-char #\@) (write-char c)
+			       (setq state 'attribute-name))))
+		     (attribute-name
+		      (cond ((char= c #\=) (write-char c)
+			     (setq state 'attribute-start))
+			    ((not whitespace) (write-char c))))
+		     (attribute-start
+		      (when (member c '(#\" #\'))
+			(setq quote-char c
+			      state 'attribute-value)))
+		     (attribute-value
+		      (if (char= c quote-char)
+			  (setq state 'attributes)
+			(write-escaped c)))
+		     (empty-tag-end
+		      (when (char= c #\>)
+			(write-string "|}")
+			(setq state 'text)))
+		     (end-tag
+		      (when (char= c #\>)
+			(write-char #\})
+			(setq state 'text)))))))
+	  (dolist (fragment fragments)
+	    (cond ((stringp fragment)
+		   (loop for c across fragment do (feed c)))
+		  ((characterp fragment)
+		   (feed fragment))
+		  (t
+		   (loop for c across (princ-to-string fragment) do (feed c)))))))))
+
   (defun mydispla (x)
     #+clisp (finish-output)
     (let ((*print-circle* nil)
 	  (*wxxml-mratp* (format nil "~{~a~}" (cdr (checkrat x)))))
-      (mapc #'princ
-	    (wxxml x '("<mth>") '("</mth>") 'mparen 'mparen)))
+      (if *wx-compact-output*
+	  (progn
+	    (write-string "<cmth>")
+	    (wx-write-compact (wxxml x '("<mth>") '("</mth>") 'mparen 'mparen))
+	    (write-string "</cmth>"))
+	(dolist (s (wxxml x '("<mth>") '("</mth>") 'mparen 'mparen))
+	  (if (stringp s)
+	      (write-string s)
+	    (princ s)))))
     #+clisp (finish-output)
     )
 
@@ -1857,35 +1989,49 @@
   (defun print_value (val)
     (format nil "<value>~a</value>" (symbol-to-xml val)))
 
+  ;; The autocompletable symbols wxMaxima already has been told about
+  (defvar *wx-published-symbols* (make-hash-table :test #'equal))
+
+  ;; Removes all symbol descriptions wxMaxima already knows about from a list
+  ;; so after a load() only the symbols the package has added are sent.
+  (defun wx-unpublished-symbols (descriptions)
+    (let ((new nil))
+      (dolist (d descriptions)
+	(unless (gethash d *wx-published-symbols*)
+	  (setf (gethash d *wx-published-symbols*) t)
+	  (push d new)))
+      (nreverse new)))
+
   (defun $add_function_template (&rest functs)
     (let ((*print-circle* nil))
-      (format t "<wxxml-symbols>~{~a~^$~}</wxxml-symbols>" (mapcar #'$print_function functs))
+      (format t "<wxxml-symbols>~{~a~^$~}</wxxml-symbols>"
+	      (wx-unpublished-symbols (mapcar #'$print_function functs)))
       (cons '(mlist simp) functs)))
 
 
   ;; A function that determines all symbols for autocompletion
   (defun wxPrint_autocompletesymbols ()
     #+clisp (finish-output)
-    (format t "<wxxml-symbols>")
-    ;; Function names and rules
-    (format t "~{~a~^$~}"
-	    (append (mapcar #'$print_function (cdr ($append $functions $macros)))
-		    (mapcar #'print_value (cdr ($append $values $rules)))))
-    ;; Idea from Robert Dodier:
-    ;; Variables defined with mdef don't appear in $values nor do they in $myoptions
-    ;; but they appear in *variable-initial-values*
-    (maphash (lambda (key val)
-	       (declare (ignore val))
-	       (if (eq (char (format nil "~a" key) 0) #\$ )
-		   (format t "~a" (print_value key))))
-	     *variable-initial-values*)
-
-    ;; ezunits publishes all known units in a function.
-    (if (boundp '$known_units)
-    	(no-warning
-    	 (format t "~{~a~^$~}"
-    		 (mapcar #'print_unit (cdr ($known_units))))))
-    (format t "</wxxml-symbols>")
+    (let ((symbols
+	   ;; Function names and rules
+	   (append (mapcar #'$print_function (cdr ($append $functions $macros)))
+		   (mapcar #'print_value (cdr ($append $values $rules))))))
+      ;; Idea from Robert Dodier:
+      ;; Variables defined with mdef don't appear in $values nor do they in $myoptions
+      ;; but they appear in *variable-initial-values*
+      (maphash (lambda (key val)
+		 (declare (ignore val))
+		 (if (eq (char (format nil "~a" key) 0) #\$ )
+		     (push (print_value key) symbols)))
+	       *variable-initial-values*)
+
+      ;; ezunits publishes all known units in a function.
+      (if (boundp '$known_units)
+	  (no-warning
+	   (setq symbols (append symbols
+				 (mapcar #'print_unit (cdr ($known_units)))))))
+      (format t "<wxxml-symbols>~{~a~^$~}</wxxml-symbols>"
+	      (wx-unpublished-symbols symbols)))
     #+clisp (finish-output)
     )
 
@@ -1902,12 +2048,139 @@
 	    (mtell "<value>~M</value>" (wxxml-fix-string(eval var)))))
     (format t "</variable>"))
 
+;;; Watched variables might contain huge values => by default wxMaxima gets
+;;; only this many characters of them, plus their size and a hash.
+  (defvar *wx-variable-preview-length* 1000)
+
+  (defun wx-string-hash (str)
+    (let ((hash 2166136261))
+      (loop for c across str do
+	(setq hash (logand (* (logxor hash (char-code c)) 16777619) #xFFFFFFFF)))
+      (format nil "~x" hash)))
+
+  (defun wx-print-queried-variable (var &optional known-hash full)
+    (format t "<variable>~%<name>~a</name>" (wxxml-fix-string (maybe-invert-string-case var)))
+    (let ((str
+	   (ignore-errors
+	     (let (($display2d nil))
+	       (with-output-to-string (*standard-output*)
+		 (mtell "~M" (meval (intern var))))))))
+      (when str
+	(let ((hash (wx-string-hash str))
+	      (len (length str)))
+	  ;; If wxMaxima already knows this value we don't need to send it again.
+	  (if (equal hash known-hash)
+	      (format t "<unchanged/>")
+	    (format t "<value>~a</value><size>~a</size><hash>~a</hash>"
+		    (wxxml-fix-string
+		     (if (and (not full) (> len *wx-variable-preview-length*))
+			 (subseq str 0 *wx-variable-preview-length*)
+		       str))
+		    len hash)))))
+    (format t "</variable>~%"))
+
   (defun wx-query-variable (var)
-    (format t "<variables>~%<variable>~%<name>~a</name>" (wxxml-fix-string (maybe-invert-string-case var)))
-    (ignore-errors
-      (let (($display2d nil))
-	(mtell "<value>~M</value>" (wxxml-fix-string(meval (intern var))))))
-      (format t "</variable>~%</variables>~%"))
+    (format t "<variables>~%")
+    (wx-print-queried-variable var)
+    (format t "</variables>~%"))
+
+;;; Answer the query for all watched variables at once so wxMaxima needs only
+;;; one round-trip to update the variables pane. vars is a list of queries,
+;;; each of which is a list
+;;; (name hash-wxMaxima-knows-the-value-for full-value-wanted).
+;;; A single list argument keeps us clear of call-arguments-limit, which is
+;;; only 64 in GCL.
+  (defun wx-query-variables (vars)
+    (format t "<variables>~%")
+    (dolist (var vars)
+      (apply #'wx-print-queried-variable var))
+    (format t "</variables>~%"))
+
+;;; Tells wxMaxima which cell the output of the next command is for.
+  (defun wx-cell-id (id)
+    (format t "<cell-id>~a</cell-id>" id))
+
+;;; wxMaxima can hand maxima the commands that follow the current one in
+;;; advance so maxima doesn't have to wait for wxMaxima between commands.
+;;; These commands are kept in a queue here instead of being written to
+;;; maxima's input: A command that asks a question (asksign, read()) reads
+;;; the answer from the input and would read the next command, instead.
+;;; Each entry is a list (cell-id command).
+  (defvar *wx-queued-commands* nil)
+;;; t = skip the queued commands if a command fails
+  (defvar *wx-queue-abort-on-error* nil)
+;;; The number of top-level commands that have started and haven't returned
+;;; normally, yet. Errors, interrupts and Lisp errors all throw past the end
+;;; of the command; errors caught by errcatch(), errset or handler-case don't.
+  (defvar *wx-unfinished-commands* 0)
+;;; Set by main-prompt(): The next dbm-read() is the top level reading a command
+  (defvar *wx-toplevel-read* nil)
+
+;;; wxMaxima sends this instead of the commands it would have sent one by one.
+;;; commands is a list of entries for *wx-queued-commands*. In the commands
+;;; newlines are written as ~% and tildes as ~~.
+  (defun wx-enqueue (abort-on-error commands)
+    (setq *wx-queue-abort-on-error* abort-on-error)
+    (setq *wx-queued-commands* (append *wx-queued-commands* commands)))
+
+;;; Drop the queued commands. wxMaxima still waits for one prompt for each of
+;;; them.
+  (defun wx-flush-queue ()
+    (dolist (command *wx-queued-commands*)
+      (wx-cell-id (first command))
+      (fresh-line)
+      (princ (wx-original-main-prompt)))
+    (finish-output)
+    (setq *wx-queued-commands* nil))
+
+  (unless (fboundp 'wx-original-main-prompt)
+    (setf (symbol-function 'wx-original-main-prompt) (symbol-function 'main-prompt)))
+  (unless (fboundp 'wx-original-dbm-read)
+    (setf (symbol-function 'wx-original-dbm-read) (symbol-function 'dbm-read)))
+  (unless (fboundp 'wx-original-toplevel-macsyma-eval)
+    (setf (symbol-function 'wx-original-toplevel-macsyma-eval)
+	  (symbol-function 'toplevel-macsyma-eval)))
+
+  (defun main-prompt (&rest args)
+    (setq *wx-toplevel-read* t)
+    (apply #'wx-original-main-prompt args))
+
+  (defun toplevel-macsyma-eval (&rest args)
+    (incf *wx-unfinished-commands*)
+    (prog1 (apply #'wx-original-toplevel-macsyma-eval args)
+      (decf *wx-unfinished-commands*)))
+
+;;; If the top level wants to read a command and we have queued commands we
+;;; let it read the next of them instead of maxima's input. The prompt is
+;;; output as if the command had been read from the input and the cell-id
+;;; follows it, as it does if wxMaxima sends the commands one by one.
+;;; Input wxMaxima has sent in the meantime (more commands to queue or the
+;;; request to drop the queue) is read first.
+  (defun dbm-read (&rest args)
+    (declare (special *mread-prompt*))
+    (let ((toplevel *wx-toplevel-read*)
+	  (failed (> *wx-unfinished-commands* 0)))
+      (setq *wx-toplevel-read* nil)
+      (when toplevel
+	(setq *wx-unfinished-commands* 0))
+      (when (and toplevel failed *wx-queued-commands* *wx-queue-abort-on-error*)
+	;; The last command hasn't finished => skip the queued commands.
+	;; wxMaxima still waits for the prompt of the command that has failed.
+	(fresh-line)
+	(princ *mread-prompt*)
+	(wx-flush-queue)
+	(let ((*mread-prompt* ""))
+	  (declare (special *mread-prompt*))
+	  (return-from dbm-read (apply #'wx-original-dbm-read args))))
+      (if (and toplevel *wx-queued-commands*
+	       (not (listen (if args (first args) *standard-input*))))
+	  (let* ((command (pop *wx-queued-commands*))
+		 (result (apply #'wx-original-dbm-read
+				(make-string-input-stream (format nil (second command)))
+				(rest args))))
+	    (wx-cell-id (first command))
+	    result)
+	  (apply #'wx-original-dbm-read args))))
 
   (defun wx-print-variables ()
     #+clisp (finish-output)
@@ -2026,7 +2299,8 @@
   ;; Load the initial functions (from mac-init.mac)
   (let ((*print-circle* nil))
     (format t "<wxxml-symbols>~{~a~^$~}</wxxml-symbols>~%"
-	    (mapcar #'$print_function (cdr ($append $functions $macros)))))
+	    (wx-unpublished-symbols
+	     (mapcar #'$print_function (cdr ($append $functions $macros))))))
 
   (no-warning
    (defun mredef-check (fnname)
@@ -27,91 +27,150 @@
   dynamically appending maxima commands to this list as soon as they are defined.
 */
 
-#include <wx/sstream.h>
 #include "Autocomplete.h"
 #include "Dirstructure.h"
 
 #include <wx/textfile.h>
 #include <wx/filename.h>
-#include <wx/xml/xml.h>
+#include <algorithm>
+#include <iterator>
 
-AutoComplete::AutoComplete(Configuration *configuration)
+AutoComplete::AutoComplete(Configuration *configuration, const WorksheetWords *worksheetWords)
 {
-  wxASSERT(m_args.Compile(wxT("[[]<([^>]*)>[]]")));
+  wxASSERT(m_args.Compile(ArgsRegEx()));
   m_configuration = configuration;
+  m_worksheetWords = worksheetWords;
+  m_dirScannerDone = true;
 }
 
-void AutoComplete::ClearWorksheetWords()
+const wxString AutoComplete::m_symbolCacheHeader(wxT("wxMaxima symbol cache, version 1"));
+
+AutoComplete::~AutoComplete()
 {
-  m_worksheetWords.clear();
+  if(m_symbolScanner.joinable())
+    m_symbolScanner.join();
+  if(m_dirScanner.joinable())
+    m_dirScanner.join();
 }
 
-void AutoComplete::AddSymbols(wxString xml)
+bool AutoComplete::AddSorted(wxArrayString &list, const wxString &word)
 {
-  wxXmlDocument xmldoc;
-  wxStringInputStream xmlStream(xml);
-  xmldoc.Load(xmlStream, wxT("UTF-8"));
-  wxXmlNode *node = xmldoc.GetRoot();
-  if(node != NULL)
-  {
-    wxXmlNode *children = node->GetChildren();
-    while (children != NULL)
-    {
-      if(children->GetType() == wxXML_ELEMENT_NODE)
-      { 
-        if (children->GetName() == wxT("function"))
-        {
-          wxXmlNode *val = children->GetChildren();
-          if(val)
-          {
-            wxString name = val->GetContent();
-            AddSymbol(name, command);
-          }
-        }
+  wxArrayString::iterator pos = std::lower_bound(list.begin(), list.end(), word);
+  if((pos != list.end()) && (*pos == word))
+    return false;
+  list.Insert(word, pos - list.begin());
+  return true;
+}
 
-        if (children->GetName() == wxT("template"))
-        {
-          wxXmlNode *val = children->GetChildren();
-          if(val)
-          {
-            wxString name = val->GetContent();
-            AddSymbol(name, tmplte);
-          }
-        }
+void AutoComplete::SortUnique(wxArrayString &list)
+{
+  std::sort(list.begin(), list.end());
+  wxArrayString::iterator newEnd = std::unique(list.begin(), list.end());
+  size_t newCount = newEnd - list.begin();
+  if(newCount < list.GetCount())
+    list.RemoveAt(newCount, list.GetCount() - newCount);
+}
 
-        if (children->GetName() == wxT("unit"))
-        {
-          wxXmlNode *val = children->GetChildren();
-          if(val)
-          {
-            wxString name = val->GetContent();
-            AddSymbol(name, unit);
-          }
-        }
+size_t AutoComplete::FindPrefix(const wxArrayString &list, const wxString &partial)
+{
+  return std::lower_bound(list.begin(), list.end(), partial) - list.begin();
+}
 
-        if (children->GetName() == wxT("value"))
-        {
-          wxXmlNode *val = children->GetChildren();
-          if(val)
-          {
-            wxString name = val->GetContent();
-            AddSymbol(name, command);
-          }
-        }
-      }
-      children = children->GetNext();
-    }
+void AutoComplete::MergeSorted(wxArrayString &list, const wxArrayString &additions)
+{
+  if(additions.IsEmpty())
+    return;
+  wxArrayString merged;
+  merged.Alloc(list.GetCount() + additions.GetCount());
+  std::merge(list.begin(), list.end(), additions.begin(), additions.end(),
+             std::back_inserter(merged));
+  wxArrayString::iterator newEnd = std::unique(merged.begin(), merged.end());
+  size_t newCount = newEnd - merged.begin();
+  if(newCount < merged.GetCount())
+    merged.RemoveAt(newCount, merged.GetCount() - newCount);
+  list = merged;
+}
+
+bool AutoComplete::SameTime(const wxDateTime &a, const wxDateTime &b)
+{
+  if(!a.IsValid() || !b.IsValid())
+    return a.IsValid() == b.IsValid();
+  return a == b;
+}
+
+wxDateTime AutoComplete::DirModificationTime(const wxString &dir)
+{
+  if(!wxDirExists(dir))
+    return wxDateTime();
+  return wxFileName::DirName(dir).GetModificationTime();
+}
+
+void AutoComplete::ClearLoadfileList()
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_wordList[loadfile] = m_builtInLoadFiles;
+}
+
+void AutoComplete::ClearDemofileList()
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_wordList[demofile] = m_builtInDemoFiles;
+}
+
+void AutoComplete::AddSymbols(wxString xml)
+{
+  // Maxima sends this list after every load() and it can be long. It consists
+  // of nothing but <tag>contents</tag> pairs => Instead of building a DOM tree
+  // we just search for these pairs.
+  size_t pos = 0;
+  while ((pos = xml.find(wxT('<'), pos)) != wxString::npos)
+  {
+    size_t tagEnd = xml.find(wxT('>'), pos);
+    if (tagEnd == wxString::npos)
+      break;
+    wxString tag = xml.Mid(pos + 1, tagEnd - pos - 1);
+    pos = tagEnd + 1;
+
+    autoCompletionType type;
+    if ((tag == wxT("function")) || (tag == wxT("value")))
+      type = command;
+    else if (tag == wxT("template"))
+      type = tmplte;
+    else if (tag == wxT("unit"))
+      type = unit;
+    else
+      continue;
+
+    wxString closingTag = wxT("</") + tag + wxT(">");
+    size_t contentEnd = xml.find(closingTag, pos);
+    if (contentEnd == wxString::npos)
+      break;
+    if (contentEnd > pos)
+      AddSymbol(UnescapeXML(xml.Mid(pos, contentEnd - pos)), type);
+    pos = contentEnd + closingTag.Length();
   }
 }
-void AutoComplete::AddWorksheetWords(wxArrayString wordlist)
+
+wxString AutoComplete::UnescapeXML(wxString text)
 {
-  wxArrayString::const_iterator it;
-  for (it = wordlist.begin(); it != wordlist.end(); ++it)
-    m_worksheetWords[*it] = 1;
+  if (text.Find(wxT('&')) == wxNOT_FOUND)
+    return text;
+  text.Replace(wxT("&lt;"), wxT("<"));
+  text.Replace(wxT("&gt;"), wxT(">"));
+  text.Replace(wxT("&quot;"), wxT("\""));
+  text.Replace(wxT("&apos;"), wxT("'"));
+  text.Replace(wxT("&amp;"), wxT("&"));
+  return text;
 }
 
 bool AutoComplete::LoadSymbols()
-{  
+{
+  // If maxima has been restarted the scan the last start has triggered
+  // might still be running.
+  if(m_symbolScanner.joinable())
+    m_symbolScanner.join();
+
+  std::lock_guard<std::mutex> lock(m_lock);
   for (int i = command; i <= unit; i++)
   {
     if (m_wordList[i].GetCount() != 0)
@@ -125,14 +184,105 @@ bool AutoComplete::LoadSymbols()
       ++it)
     m_wordList[esccommand].Add(it->first);
 
-  wxString line;
+  for (int i = command; i <= unit; i++)
+  {
+    SortUnique(m_wordList[i]);
+    // Maxima only tells us about symbols we haven't heard of, yet.
+    MergeSorted(m_wordList[i], m_learnedSymbols[i]);
+  }
+  m_wordList[loadfile] = m_builtInLoadFiles;
+  m_wordList[demofile] = m_builtInDemoFiles;
 
-  /// Load private symbol list (do something different on Windows).
-  wxString privateList;
-  privateList = Dirstructure::Get()->UserAutocompleteFile();
+  wxString shareDir;
+  if(m_configuration->MaximaShareDir() != wxEmptyString)
+  {
+    wxFileName shareDirName(m_configuration->MaximaShareDir() + "/");
+    shareDirName.MakeAbsolute();
+    shareDir = shareDirName.GetFullPath();
+  }
+  wxFileName userDir(Dirstructure::Get()->UserConfDir() + "/");
+  userDir.MakeAbsolute();
+
+  m_symbolScanner = std::thread(&AutoComplete::LoadSymbols_BackgroundTask, this,
+                                Dirstructure::Get()->UserAutocompleteFile(),
+                                shareDir, userDir.GetFullPath(),
+                                Dirstructure::Get()->UserSymbolCacheFile());
+  return false;
+}
+
+bool AutoComplete::ReadSymbolCache(wxString cacheFile, wxString shareDir, wxDateTime shareDirTime,
+                                   wxArrayString &loadFiles, wxArrayString &demoFiles)
+{
+  if (!shareDirTime.IsValid() || !wxFileExists(cacheFile))
+    return false;
+
+  wxTextFile cache(cacheFile);
+  if (!cache.Open())
+    return false;
+
+  // The share dir's path contains maxima's version number => If the path and
+  // the modification date match the cache belongs to this maxima version.
+  if ((cache.GetLineCount() < 3) ||
+      (cache.GetLine(0) != m_symbolCacheHeader) ||
+      (cache.GetLine(1) != wxT("SHAREDIR: ") + shareDir) ||
+      (cache.GetLine(2) != wxT("MTIME: ") + shareDirTime.GetValue().ToString()))
+    return false;
+
+  for (size_t i = 3; i < cache.GetLineCount(); i++)
+  {
+    wxString line = cache.GetLine(i);
+    if (line.StartsWith(wxT("LOADFILE: ")))
+      loadFiles.Add(line.Mid(10));
+    else if (line.StartsWith(wxT("DEMOFILE: ")))
+      demoFiles.Add(line.Mid(10));
+  }
+  cache.Close();
+  wxLogMessage(
+    wxString::Format(
+      _("Autocompletion: Read the list of loadable files in %s from %s."),
+      shareDir.utf8_str(), cacheFile.utf8_str()));
+  return true;
+}
+
+void AutoComplete::WriteSymbolCache(wxString cacheFile, wxString shareDir, wxDateTime shareDirTime,
+                                    const wxArrayString &loadFiles, const wxArrayString &demoFiles)
+{
+  if (!shareDirTime.IsValid())
+    return;
+
+  wxLogNull suppressErrors;
+  wxTextFile cache(cacheFile);
+  if (wxFileExists(cacheFile))
+  {
+    if (!cache.Open())
+      return;
+    cache.Clear();
+  }
+  else if (!cache.Create())
+    return;
+
+  cache.AddLine(m_symbolCacheHeader);
+  cache.AddLine(wxT("SHAREDIR: ") + shareDir);
+  cache.AddLine(wxT("MTIME: ") + shareDirTime.GetValue().ToString());
+  for (size_t i = 0; i < loadFiles.GetCount(); i++)
+    cache.AddLine(wxT("LOADFILE: ") + loadFiles[i]);
+  for (size_t i = 0; i < demoFiles.GetCount(); i++)
+    cache.AddLine(wxT("DEMOFILE: ") + demoFiles[i]);
+  cache.Write();
+  cache.Close();
+}
+
+void AutoComplete::LoadSymbols_BackgroundTask(wxString privateList, wxString shareDir, wxString userDir,
+                                              wxString cacheFile)
+{
+  wxArrayString commands;
+  wxArrayString templates;
+  wxArrayString units;
 
+  /// Load private symbol list (do something different on Windows).
   if (wxFileExists(privateList))
   {
+    wxString line;
     wxTextFile priv(privateList);
 
     priv.Open();
@@ -141,108 +291,127 @@ bool AutoComplete::LoadSymbols()
     {
       if (line.StartsWith(wxT("FUNCTION: ")) ||
           line.StartsWith(wxT("OPTION  : ")))
-        m_wordList[command].Add(line.Mid(10));
+        commands.Add(line.Mid(10));
       else if (line.StartsWith(wxT("TEMPLATE: ")))
-        m_wordList[tmplte].Add(FixTemplate(line.Mid(10)));
+        templates.Add(line.Mid(10));
       else if (line.StartsWith(wxT("UNIT: ")))
-        m_wordList[unit].Add(FixTemplate(line.Mid(6)));
+        units.Add(line.Mid(6));
     }
 
     priv.Close();
   }
-  
-  // Prepare a list of all built-in loadable files of maxima.
+
+  // Scanning maxima's share dir is what takes the most time. Its contents only
+  // change if maxima is updated => We can reuse the result of the last scan.
+  wxDateTime shareDirTime = DirModificationTime(shareDir);
+  bool shareDirKnown;
   {
-    GetMacFiles_includingSubdirs maximaLispIterator (m_builtInLoadFiles);
-    if(m_configuration->MaximaShareDir() != wxEmptyString)
+    std::lock_guard<std::mutex> lock(m_lock);
+    shareDirKnown = (shareDir == m_scannedShareDir) &&
+      SameTime(shareDirTime, m_scannedShareDirTime);
+  }
+
+  wxArrayString shareDirLoadFiles;
+  wxArrayString demoFiles;
+  if(!shareDirKnown &&
+     ReadSymbolCache(cacheFile, shareDir, shareDirTime, shareDirLoadFiles, demoFiles))
+  {
+    SortUnique(shareDirLoadFiles);
+    SortUnique(demoFiles);
+  }
+  else if(!shareDirKnown)
+  {
+    // Prepare a list of all built-in loadable files of maxima.
+    if(shareDir != wxEmptyString)
     {
-      wxFileName shareDir(m_configuration->MaximaShareDir() + "/");
-      shareDir.MakeAbsolute();
+      GetMacFiles_includingSubdirs maximaLispIterator (shareDirLoadFiles);
       wxLogMessage(
         wxString::Format(
           _("Autocompletion: Scanning %s for loadable lisp files."),
-          shareDir.GetFullPath().utf8_str()));
-      wxDir maximadir(shareDir.GetFullPath());
+          shareDir.utf8_str()));
+      wxDir maximadir(shareDir);
       if(maximadir.IsOpened())
         maximadir.Traverse(maximaLispIterator);
     }
-    GetMacFiles userLispIterator (m_builtInLoadFiles);
- 
-    wxFileName userDir(Dirstructure::Get()->UserConfDir() + "/");
-    userDir.MakeAbsolute();
-    wxDir maximauserfilesdir(userDir.GetFullPath());
+    SortUnique(shareDirLoadFiles);
+
+    // Prepare a list of all built-in demos of maxima.
+    if(shareDir != wxEmptyString)
+    {
+      wxFileName demoDir(shareDir);
+      demoDir.RemoveLastDir();
+      GetDemoFiles_includingSubdirs maximaDemoIterator (demoFiles);
+      wxLogMessage(
+        wxString::Format(
+          _("Autocompletion: Scanning %s for loadable demo files."),
+          demoDir.GetFullPath().utf8_str()));
+
+      wxDir maximadir(demoDir.GetFullPath());
+      if(maximadir.IsOpened())
+        maximadir.Traverse(maximaDemoIterator);
+    }
+    SortUnique(demoFiles);
+    WriteSymbolCache(cacheFile, shareDir, shareDirTime, shareDirLoadFiles, demoFiles);
+  }
+
+  // The user's own files are few and tend to change => always re-read them.
+  wxArrayString userLoadFiles;
+  {
+    GetMacFiles userLispIterator (userLoadFiles);
+    wxDir maximauserfilesdir(userDir);
     wxLogMessage(
       wxString::Format(
         _("Autocompletion: Scanning %s for loadable lisp files."),
-        userDir.GetFullPath().utf8_str()));
+        userDir.utf8_str()));
     if(maximauserfilesdir.IsOpened())
       maximauserfilesdir.Traverse(userLispIterator);
+    SortUnique(userLoadFiles);
   }
-  
 
-  // Prepare a list of all built-in demos of maxima.
+  // m_args belongs to the GUI thread.
+  wxRegEx args(ArgsRegEx());
+  for (size_t i = 0; i < templates.GetCount(); i++)
+    templates[i] = FixTemplate(templates[i], args);
+  for (size_t i = 0; i < units.GetCount(); i++)
+    units[i] = FixTemplate(units[i], args);
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  SortUnique(commands);
+  MergeSorted(m_wordList[command], commands);
+  SortUnique(templates);
+  MergeSorted(m_wordList[tmplte], templates);
+  SortUnique(units);
+  MergeSorted(m_wordList[unit], units);
+
+  if(!shareDirKnown)
   {
-    wxFileName demoDir(m_configuration->MaximaShareDir() + "/");
-    demoDir.MakeAbsolute();
-    demoDir.RemoveLastDir();
-    GetDemoFiles_includingSubdirs maximaLispIterator (m_builtInDemoFiles);
-    wxLogMessage(
-      wxString::Format(
-        _("Autocompletion: Scanning %s for loadable demo files."),
-        demoDir.GetFullPath().utf8_str()));
-
-    wxDir maximadir(demoDir.GetFullPath());
-    if(maximadir.IsOpened())
-      maximadir.Traverse(maximaLispIterator);
+    m_shareDirLoadFiles = shareDirLoadFiles;
+    m_builtInDemoFiles = demoFiles;
+    m_scannedShareDir = shareDir;
+    m_scannedShareDirTime = shareDirTime;
   }
-  
-  m_wordList[command].Sort();
-  m_wordList[tmplte].Sort();
-  m_wordList[unit].Sort();
-  m_builtInLoadFiles.Sort();
-  m_builtInDemoFiles.Sort();
-  return false;
+  m_builtInLoadFiles = m_shareDirLoadFiles;
+  MergeSorted(m_builtInLoadFiles, userLoadFiles);
+  m_wordList[loadfile] = m_builtInLoadFiles;
+  m_wordList[demofile] = m_builtInDemoFiles;
 }
 
 void AutoComplete::UpdateDemoFiles(wxString partial, wxString maximaDir)
 {
-  // Remove the opening quote from the partial.
-  if(partial[0] == wxT('\"'))
-    partial = partial.Right(partial.Length()-1);
-  
-  partial.Replace(wxFileName::GetPathSeparator(), "/");
-  int pos;
-  if ((pos = partial.Find(wxT('/'), true)) == wxNOT_FOUND)
-    partial = wxEmptyString;
-  else
-    partial = partial.Left(pos);
-  wxString prefix = partial + wxT("/");
-  
-  // Determine if we need to add the path to maxima's current dir to the path in partial
-  if(!wxFileName(partial).IsAbsolute())
-  {
-    partial = maximaDir + wxFileName::GetPathSeparator() + partial;
-    partial.Replace(wxFileName::GetPathSeparator(), "/");
-  }
-  
-  // Determine the name of the directory
-  if((partial != wxEmptyString) && wxDirExists(partial))
-    partial += "/";
+  UpdateFileList(demofile, partial, maximaDir);
+}
 
-  // Remove all files from the maxima directory from the demo file list
-  ClearDemofileList();
+void AutoComplete::UpdateGeneralFiles(wxString partial, wxString maximaDir)
+{
+  UpdateFileList(generalfile, partial, maximaDir);
+}
 
-  // Add all files from the maxima directory to the demo file list
-  if(partial != wxT("//"))
-  {
-    GetDemoFiles userLispIterator(m_wordList[demofile], prefix);
-    wxDir demofilesdir(partial);
-    if(demofilesdir.IsOpened())
-      demofilesdir.Traverse(userLispIterator);
-  }
+void AutoComplete::UpdateLoadFiles(wxString partial, wxString maximaDir)
+{
+  UpdateFileList(loadfile, partial, maximaDir);
 }
 
-void AutoComplete::UpdateGeneralFiles(wxString partial, wxString maximaDir)
+void AutoComplete::UpdateFileList(autoCompletionType type, wxString partial, wxString maximaDir)
 {
   // Remove the opening quote from the partial.
   if(partial[0] == wxT('\"'))
@@ -266,52 +435,134 @@ void AutoComplete::UpdateGeneralFiles(wxString partial, wxString maximaDir)
   // Determine the name of the directory
   if((partial != wxEmptyString) && wxDirExists(partial))
     partial += "/";
-  
-  // Add all files from the maxima directory to the demo file list
+
+  wxArrayString files;
   if(partial != wxT("//"))
   {
-    GetGeneralFiles fileIterator(m_wordList[generalfile], prefix);
-    wxDir generalfilesdir(partial);
-    if(generalfilesdir.IsOpened())
-      generalfilesdir.Traverse(fileIterator);
+    wxString key = wxString::Format(wxT("%i\n"), type) + prefix + wxT("\n") + partial;
+    wxDateTime modificationTime = DirModificationTime(partial);
+    bool cached = false;
+    bool stale = false;
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      std::map<wxString, DirListing>::const_iterator it = m_dirCache.find(key);
+      if(it != m_dirCache.end())
+      {
+        cached = true;
+        files = it->second.m_files;
+        if(!SameTime(it->second.m_modificationTime, modificationTime))
+        {
+          stale = true;
+          bool alreadyQueued = false;
+          for(std::list<StaleDir>::const_iterator i = m_staleDirs.begin(); i != m_staleDirs.end(); ++i)
+            if(i->m_key == key)
+              alreadyQueued = true;
+          if(!alreadyQueued)
+          {
+            StaleDir dir = {key, type, partial, prefix};
+            m_staleDirs.push_back(dir);
+          }
+        }
+      }
+    }
+
+    if(!cached)
+    {
+      // There is no old listing we could offer until a background scan is
+      // finished => scan this directory right now.
+      files = ScanDirectory(type, partial, prefix);
+      std::lock_guard<std::mutex> lock(m_lock);
+      DirListing listing = {modificationTime, files};
+      m_dirCache[key] = listing;
+    }
+
+    if(stale)
+    {
+      // Serve the old listing while the background thread reads the new one.
+      if(m_dirScanner.joinable() && m_dirScannerDone)
+        m_dirScanner.join();
+      if(!m_dirScanner.joinable())
+      {
+        m_dirScannerDone = false;
+        m_dirScanner = std::thread(&AutoComplete::RescanDirs_BackgroundTask, this);
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  switch(type)
+  {
+  case loadfile:
+    // Remove all files from the maxima directory from the load file list
+    m_wordList[loadfile] = m_builtInLoadFiles;
+    break;
+  case demofile:
+    // Remove all files from the maxima directory from the demo file list
+    m_wordList[demofile] = m_builtInDemoFiles;
+    break;
+  default:
+    break;
   }
+  // Add all files from the maxima directory to the file list
+  MergeSorted(m_wordList[type], files);
 }
 
-void AutoComplete::UpdateLoadFiles(wxString partial, wxString maximaDir)
+wxArrayString AutoComplete::ScanDirectory(autoCompletionType type, wxString dir, wxString prefix)
 {
-  // Remove the opening quote from the partial.
-  if(partial[0] == wxT('\"'))
-    partial = partial.Right(partial.Length()-1);
-  
-  partial.Replace(wxFileName::GetPathSeparator(), "/");
-  int pos;
-  if ((pos = partial.Find(wxT('/'), true)) == wxNOT_FOUND)
-    partial = wxEmptyString;
-  else
-    partial = partial.Left(pos);
-  wxString prefix = partial + wxT("/");
-  
-  // Determine if we need to add the path to maxima's current dir to the path in partial
-  if(!wxFileName(partial).IsAbsolute())
+  wxArrayString files;
+  wxDir directory(dir);
+  if(directory.IsOpened())
   {
-    partial = maximaDir + wxFileName::GetPathSeparator() + partial;
-    partial.Replace(wxFileName::GetPathSeparator(), "/");
+    switch(type)
+    {
+    case loadfile:
+    {
+      GetMacFiles userLispIterator(files, prefix);
+      directory.Traverse(userLispIterator);
+      break;
+    }
+    case demofile:
+    {
+      GetDemoFiles userDemoIterator(files, prefix);
+      directory.Traverse(userDemoIterator);
+      break;
+    }
+    default:
+    {
+      GetGeneralFiles fileIterator(files, prefix);
+      directory.Traverse(fileIterator);
+      break;
+    }
+    }
   }
-  
-  // Determine the name of the directory
-  if((partial != wxEmptyString) && wxDirExists(partial))
-    partial += "/";
-
-  // Remove all files from the maxima directory from the load file list
-  ClearLoadfileList();
+  SortUnique(files);
+  return files;
+}
 
-  // Add all files from the maxima directory to the load file list
-  if(partial != wxT("//"))
+void AutoComplete::RescanDirs_BackgroundTask()
+{
+  while(true)
   {
-    GetMacFiles userLispIterator(m_wordList[loadfile], prefix);
-    wxDir loadfilesdir(partial);
-    if(loadfilesdir.IsOpened())
-      loadfilesdir.Traverse(userLispIterator);
+    StaleDir dir;
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if(m_staleDirs.empty())
+      {
+        // Setting this flag while holding the lock guarantees that nobody can
+        // queue a directory we don't see any more.
+        m_dirScannerDone = true;
+        return;
+      }
+      dir = m_staleDirs.front();
+      m_staleDirs.pop_front();
+    }
+
+    DirListing listing;
+    listing.m_modificationTime = DirModificationTime(dir.m_dir);
+    listing.m_files = ScanDirectory(dir.m_type, dir.m_dir, dir.m_prefix);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_dirCache[dir.m_key] = listing;
   }
 }
 
@@ -328,51 +579,49 @@ wxArrayString AutoComplete::CompleteSymbol(wxString partial, autoCompletionType
     partial = partial.Left(partial.Length() - 1);
   
   wxASSERT_MSG((type >= command) && (type <= unit), _("Bug: Autocompletion requested for unknown type of item."));
-  
-  if (type != tmplte)
-  {
-    for (size_t i = 0; i < m_wordList[type].GetCount(); i++)
-    {
-      if (m_wordList[type][i].StartsWith(partial) &&
-          completions.Index(m_wordList[type][i]) == wxNOT_FOUND)
-        completions.Add(m_wordList[type][i]);
-    }
-  }
-  else
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  // The word lists are sorted and free of duplicates => All words that start
+  // with partial form one contiguous range we can find by a binary search.
+  const wxArrayString &wordList = m_wordList[type];
+  for (size_t i = FindPrefix(wordList, partial);
+       (i < wordList.GetCount()) && wordList[i].StartsWith(partial);
+       i++)
   {
-    for (size_t i = 0; i < m_wordList[type].GetCount(); i++)
-    {
-      wxString templ = m_wordList[type][i];
-      if (templ.StartsWith(partial))
-      {
-        if (completions.Index(templ) == wxNOT_FOUND)
-          completions.Add(templ);
-        if (templ.SubString(0, templ.Find(wxT("(")) - 1) == partial &&
-            perfectCompletions.Index(templ) == wxNOT_FOUND)
-          perfectCompletions.Add(templ);
-      }
-    }
+    completions.Add(wordList[i]);
+    if ((type == tmplte) &&
+        (wordList[i].SubString(0, wordList[i].Find(wxT("(")) - 1) == partial))
+      perfectCompletions.Add(wordList[i]);
   }
 
   // Add a list of words that were definied on the work sheet but that aren't
   // defined as maxima commands or functions.
-  if (type == command)
+  if ((type == command) && (m_worksheetWords != NULL))
   {
+    size_t builtinCompletions = completions.GetCount();
     WorksheetWords::const_iterator it;
-    for (it = m_worksheetWords.begin(); it != m_worksheetWords.end(); ++it)
+    for (it = m_worksheetWords->lower_bound(partial);
+         (it != m_worksheetWords->end()) && it->first.StartsWith(partial);
+         ++it)
     {
-      if (it->first.StartsWith(partial))
-      {
-        if (completions.Index(it->first) == wxNOT_FOUND)
-        {
-          completions.Add(it->first);
-        }
-      }
+      // The word that is currently being typed appears in the worksheet, too.
+      // But it only is a valid completion if it appears somewhere else, too.
+      if ((it->first == partial) && (it->second < 2))
+        continue;
+
+      // Both lists are sorted => duplicates can be found by a binary search
+      // in the part of the result that stems from the builtin list.
+      if(!std::binary_search(completions.begin(),
+                             completions.begin() + builtinCompletions,
+                             it->first))
+        completions.Add(it->first);
     }
+    if(completions.GetCount() > builtinCompletions)
+      std::inplace_merge(completions.begin(),
+                         completions.begin() + builtinCompletions,
+                         completions.end());
   }
 
-  completions.Sort();
-
   if (perfectCompletions.Count() > 0)
     return perfectCompletions;
   return completions;
@@ -397,9 +646,13 @@ void AutoComplete::AddSymbol(wxString fun, autoCompletionType type)
     type = unit;
   }
 
+  std::lock_guard<std::mutex> lock(m_lock);
   /// Add symbols
-  if ((type != tmplte) && m_wordList[type].Index(fun, true, true) == wxNOT_FOUND)
-    m_wordList[type].Add(fun);
+  if (type != tmplte)
+  {
+    AddSorted(m_wordList[type], fun);
+    AddSorted(m_learnedSymbols[type], fun);
+  }
 
   /// Add templates - for given function and given argument count we
   /// only add one template. We count the arguments by counting '<'
@@ -408,25 +661,33 @@ void AutoComplete::AddSymbol(wxString fun, autoCompletionType type)
     fun = FixTemplate(fun);
     wxString funName = fun.SubString(0, fun.Find(wxT("(")));
     long count = fun.Freq('<');
-    size_t i = 0;
-    for (i = 0; i < m_wordList[type].GetCount(); i++)
+    const wxArrayString &templates = m_wordList[type];
+    for (size_t i = FindPrefix(templates, funName);
+         (i < templates.GetCount()) && templates[i].StartsWith(funName);
+         i++)
     {
-      wxString t = m_wordList[type][i];
-      if (t.StartsWith(funName) && (t.Freq('<') == count))
-        break;
+      if (templates[i].Freq('<') == count)
+        return;
     }
-    if (i == m_wordList[type].GetCount())
-      m_wordList[type].Add(fun);
+    AddSorted(m_wordList[type], fun);
+    AddSorted(m_learnedSymbols[type], fun);
   }
 }
 
-wxString AutoComplete::FixTemplate(wxString templ)
+void AutoComplete::ClearLearnedSymbols()
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  for (int i = command; i <= unit; i++)
+    m_learnedSymbols[i].Clear();
+}
+
+wxString AutoComplete::FixTemplate(wxString templ, wxRegEx &args)
 {
   templ.Replace(wxT(" "), wxEmptyString);
   templ.Replace(wxT(",..."), wxEmptyString);
 
   /// This will change optional arguments
-  m_args.ReplaceAll(&templ, wxT("<[\\1]>"));
+  args.ReplaceAll(&templ, wxT("<[\\1]>"));
 
   return templ;
 }
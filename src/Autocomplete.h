@@ -35,6 +35,11 @@
 #include <wx/arrstr.h>
 #include <wx/regex.h>
 #include <wx/filename.h>
+#include <map>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <atomic>
 #include "Configuration.h"
 
 /* The autocompletion logic
@@ -45,12 +50,22 @@
        "values" and "functions" after a package is loaded.
      - all words that appear in the worksheet
      - and a list of maxima's builtin commands.
+
+   All word lists are kept sorted and free of duplicates so all words starting
+   with a given prefix can be found by a binary search instead of by traversing
+   the whole list on every keypress.
+
+   Scanning directories for loadable files can take seconds on network drives
+   or on big maxima installations. These scans therefore are done in the
+   background, their results are cached and until a scan has finished the
+   autocompletion is served from the cached lists.
  */
 class AutoComplete
 {
-  WX_DECLARE_STRING_HASH_MAP(int, WorksheetWords);
-
 public:
+  //! The words that appear in the worksheet and how often they appear there
+  typedef std::map<wxString, int> WorksheetWords;
+
   //! All types of things we can autocomplete
   enum autoCompletionType
   {
@@ -63,11 +78,24 @@ public:
     unit    //! Unit names. \attention Must be the last entry in this enum
   };
 
-  explicit AutoComplete(Configuration *configuration);
+  /*! The constructor
+
+    \param configuration The worksheet's configuration
+    \param worksheetWords The table of words the worksheet's EditorCells keep
+    up-to-date
+  */
+  AutoComplete(Configuration *configuration, const WorksheetWords *worksheetWords);
+  //! Waits for all background tasks to finish
+  ~AutoComplete();
 
   Configuration *m_configuration;
 
-  //! Load all autocomplete symbols wxMaxima knows about by itself
+  /*! Load all autocomplete symbols wxMaxima knows about by itself
+
+    The builtin symbols are available as soon as this function returns.
+    The private symbol list and the lists of loadable files and demos are
+    read by a background thread.
+   */
   bool LoadSymbols();
 
   /*! Makes wxMaxima know all its builtin symbols.
@@ -80,6 +108,12 @@ public:
 
   //! Manually add a autocompletable symbol to our symbols lists
   void AddSymbol(wxString fun, autoCompletionType type = command);
+  /*! Forget the symbols maxima and the user's input have told us about
+
+    Called when maxima is restarted: The new maxima doesn't know them.
+    They vanish from the symbol lists on the next LoadSymbols().
+   */
+  void ClearLearnedSymbols();
   //! Interprets the XML autocompletable symbol list maxima can send us
   void AddSymbols(wxString xml);
 
@@ -90,21 +124,114 @@ public:
   //! Assemble a list of files
   void UpdateGeneralFiles(wxString partial, wxString maximaDir);
   
-  //! Add words to the list of words that appear in the workSheet's code cells
-  void AddWorksheetWords(wxArrayString wordlist);
-
-  //! Clear the list of words that appear in the workSheet's code cells
-  void ClearWorksheetWords();
   //! Clear the list of files load() can be applied on
-  void ClearLoadfileList(){m_wordList[loadfile] = m_builtInLoadFiles;}
+  void ClearLoadfileList();
   //! Clear the list of files demo() can be applied on
-  void ClearDemofileList(){m_wordList[demofile] = m_builtInDemoFiles;}
+  void ClearDemofileList();
   
-  //! Returns a list of possible autocompletions for the string "partial"
+  //! Returns a sorted list of possible autocompletions for the string "partial"
   wxArrayString CompleteSymbol(wxString partial, autoCompletionType type = command);
-  wxString FixTemplate(wxString templ);
+  wxString FixTemplate(wxString templ){return FixTemplate(templ, m_args);}
+  /*! Converts a template into the form the autocompletion uses
+
+    \param args A regex compiled with ArgsRegEx(). wxRegEx isn't thread-safe
+                so each thread needs a regex of its own.
+   */
+  static wxString FixTemplate(wxString templ, wxRegEx &args);
+  //! The regex FixTemplate() needs
+  static wxString ArgsRegEx(){return wxT("[[]<([^>]*)>[]]");}
 
 private:
+  /*! Adds a word to a sorted word list
+
+    \return false, if the word already was in the list.
+  */
+  static bool AddSorted(wxArrayString &list, const wxString &word);
+  //! Sorts a word list and removes all duplicates from it
+  static void SortUnique(wxArrayString &list);
+  //! The index of the first entry of a sorted list that might start with partial
+  static size_t FindPrefix(const wxArrayString &list, const wxString &partial);
+  //! Adds all entries of a sorted list to another sorted list
+  static void MergeSorted(wxArrayString &list, const wxArrayString &additions);
+
+  /*! Reads the private symbol list and scans the share dir for loadable files
+
+    Is run in m_symbolScanner.
+   */
+  void LoadSymbols_BackgroundTask(wxString privateList, wxString shareDir, wxString userDir,
+                                  wxString cacheFile);
+
+  /*! Reads the list of files in maxima's share dir from the file we cache it in
+
+    \return false, if the cache doesn't exist or is out of date.
+   */
+  bool ReadSymbolCache(wxString cacheFile, wxString shareDir, wxDateTime shareDirTime,
+                       wxArrayString &loadFiles, wxArrayString &demoFiles);
+  //! Caches the list of files in maxima's share dir so the next start needn't scan it
+  static void WriteSymbolCache(wxString cacheFile, wxString shareDir, wxDateTime shareDirTime,
+                               const wxArrayString &loadFiles, const wxArrayString &demoFiles);
+  //! The first line of the file the share dir's contents are cached in
+  static const wxString m_symbolCacheHeader;
+  //! Converts the XML entities maxima escapes its symbol names with back to characters
+  static wxString UnescapeXML(wxString text);
+  /*! The symbols maxima or the user's input have told us about, by type
+
+    Maxima only sends us symbols it hasn't told us about before. These therefore
+    need to survive re-loading the list of builtin symbols.
+   */
+  wxArrayString m_learnedSymbols[7];
+
+  /*! Updates the list of files of one type in the directory partial points to
+
+    \param type loadfile, demofile or generalfile
+    \param partial The partial file name the user has entered
+    \param maximaDir The directory the current file is in
+   */
+  void UpdateFileList(autoCompletionType type, wxString partial, wxString maximaDir);
+  //! Lists the files of the type type that the directory dir contains
+  static wxArrayString ScanDirectory(autoCompletionType type, wxString dir, wxString prefix);
+  //! Re-reads the directory listings in m_staleDirs. Is run in m_dirScanner.
+  void RescanDirs_BackgroundTask();
+
+  //! A cached directory listing
+  struct DirListing
+  {
+    //! The modification time of the directory when it was scanned
+    wxDateTime m_modificationTime;
+    //! The files of the requested type the directory contains, sorted
+    wxArrayString m_files;
+  };
+  //! A directory to re-scan
+  struct StaleDir
+  {
+    wxString m_key;
+    autoCompletionType m_type;
+    wxString m_dir;
+    wxString m_prefix;
+  };
+  //! The cached listings of all directories we have looked at, by type, prefix and path
+  std::map<wxString, DirListing> m_dirCache;
+  //! The directories whose cached listings are out of date
+  std::list<StaleDir> m_staleDirs;
+  //! The loadable files maxima's share dir contains
+  wxArrayString m_shareDirLoadFiles;
+  //! The share dir m_shareDirLoadFiles and m_builtInDemoFiles have been read from
+  wxString m_scannedShareDir;
+  //! The modification time of m_scannedShareDir at the time of the scan
+  wxDateTime m_scannedShareDirTime;
+  //! Tells if two modification times (that might be invalid) are equal
+  static bool SameTime(const wxDateTime &a, const wxDateTime &b);
+  //! The modification time of a directory or an invalid date, if it doesn't exist
+  static wxDateTime DirModificationTime(const wxString &dir);
+
+  //! The thread that reads the private symbol list and maxima's share dir
+  std::thread m_symbolScanner;
+  //! The thread that re-reads out-of-date directory listings
+  std::thread m_dirScanner;
+  //! Tells if m_dirScanner has finished its work
+  std::atomic<bool> m_dirScannerDone;
+  //! Protects all lists the background threads write to
+  std::mutex m_lock;
 
   wxArrayString m_builtInLoadFiles;
   wxArrayString m_builtInDemoFiles;
@@ -119,8 +246,7 @@ private:
         wxFileName newItemName(filename);
         wxString newItem = "\"" + m_prefix + newItemName.GetFullName() + "\"";
         newItem.Replace(wxFileName::GetPathSeparator(),"/");
-        if(m_files.Index(newItem) == wxNOT_FOUND)
-          m_files.Add(newItem);
+        m_files.Add(newItem);
         return wxDIR_CONTINUE;
       }
     virtual wxDirTraverseResult OnDir(const wxString& dirname) override
@@ -128,8 +254,7 @@ private:
         wxFileName newItemName(dirname);
         wxString newItem = "\"" + m_prefix + newItemName.GetFullName() + "/\"";
         newItem.Replace(wxFileName::GetPathSeparator(),"/");
-        if(m_files.Index(newItem) == wxNOT_FOUND)
-          m_files.Add(newItem);
+        m_files.Add(newItem);
         return wxDIR_IGNORE;
       }
     wxArrayString& GetResult(){return m_files;}
@@ -154,8 +279,7 @@ private:
           wxFileName newItemName(filename);
           wxString newItem = "\"" + m_prefix + newItemName.GetName() + "\"";
           newItem.Replace(wxFileName::GetPathSeparator(),"/");
-          if(m_files.Index(newItem) == wxNOT_FOUND)
-            m_files.Add(newItem);
+          m_files.Add(newItem);
         }
         return wxDIR_CONTINUE;
       }
@@ -187,8 +311,7 @@ private:
         wxFileName newItemName(dirname);
         wxString newItem = "\"" + m_prefix + newItemName.GetFullName() + "/\"";
         newItem.Replace(wxFileName::GetPathSeparator(),"/");
-        if(m_files.Index(newItem) == wxNOT_FOUND)
-          m_files.Add(newItem);
+        m_files.Add(newItem);
         return wxDIR_IGNORE;
       }
   };
@@ -205,8 +328,7 @@ private:
           wxFileName newItemName(filename);
           wxString newItem = "\"" + m_prefix + newItemName.GetName() + "\"";
           newItem.Replace(wxFileName::GetPathSeparator(),"/");
-          if(m_files.Index(newItem) == wxNOT_FOUND)
-            m_files.Add(newItem);
+          m_files.Add(newItem);
         }
         return wxDIR_CONTINUE;
       }
@@ -238,15 +360,15 @@ private:
         wxFileName newItemName(dirname);
         wxString newItem = "\"" + m_prefix + newItemName.GetFullName() + "/\"";
         newItem.Replace(wxFileName::GetPathSeparator(),"/");
-        if(m_files.Index(newItem) == wxNOT_FOUND)
-          m_files.Add(newItem);
+        m_files.Add(newItem);
         return wxDIR_IGNORE;
       }
   };
 
   wxArrayString m_wordList[7];
   wxRegEx m_args;
-  WorksheetWords m_worksheetWords;
+  //! The words that appear in the worksheet's code cells
+  const WorksheetWords *m_worksheetWords;
 };
 
 #endif // AUTOCOMPLETE_H
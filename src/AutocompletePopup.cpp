@@ -38,7 +38,6 @@
 void AutocompletePopup::UpdateResults()
 {
   m_completions = m_autocomplete->CompleteSymbol(m_partial, m_type);
-  m_completions.Sort();
 
   switch (m_completions.GetCount())
   {
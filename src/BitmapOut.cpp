@@ -291,41 +291,49 @@ void BitmapOut::Draw()
 }
 
 wxSize BitmapOut::ToFile(wxString file)
+{
+  wxImage img;
+  wxSize retval = ToImage(img);
+
+  if (SaveImage(img, file))
+    return retval;
+  else
+  {
+    retval.x = -1;
+    retval.y = -1;
+    return retval;
+  };
+}
+
+wxSize BitmapOut::ToImage(wxImage &image)
 {
   // Assign an resolution to the bitmap.
-  wxImage img = m_bmp.ConvertToImage();
-  int resolution = img.GetOptionInt(wxIMAGE_OPTION_RESOLUTION);
+  image = m_bmp.ConvertToImage();
+  int resolution = image.GetOptionInt(wxIMAGE_OPTION_RESOLUTION);
   if (resolution <= 0)
     resolution = 75;
-  img.SetOption(wxIMAGE_OPTION_RESOLUTION, resolution * m_scale);
+  image.SetOption(wxIMAGE_OPTION_RESOLUTION, resolution * m_scale);
+
+  wxSize retval;
+  retval.x = GetRealWidth();
+  retval.y = GetRealHeight();
+  return retval;
+}
 
-  bool success = false;
+bool BitmapOut::SaveImage(const wxImage &image, wxString file)
+{
   if (file.Right(4) == wxT(".bmp"))
-    success = img.SaveFile(file, wxBITMAP_TYPE_BMP);
+    return image.SaveFile(file, wxBITMAP_TYPE_BMP);
   else if (file.Right(4) == wxT(".xpm"))
-    success = img.SaveFile(file, wxBITMAP_TYPE_XPM);
+    return image.SaveFile(file, wxBITMAP_TYPE_XPM);
   else if (file.Right(4) == wxT(".jpg"))
-    success = img.SaveFile(file, wxBITMAP_TYPE_JPEG);
+    return image.SaveFile(file, wxBITMAP_TYPE_JPEG);
   else
   {
     if (file.Right(4) != wxT(".png"))
       file = file + wxT(".png");
-    success = img.SaveFile(file, wxBITMAP_TYPE_PNG);
-  }
-
-  wxSize retval;
-  if (success)
-  {
-    retval.x = GetRealWidth();
-    retval.y = GetRealHeight();
-    return retval;
+    return image.SaveFile(file, wxBITMAP_TYPE_PNG);
   }
-  else
-  {
-    retval.x = -1;
-    retval.y = -1;
-    return retval;
-  };
 }
 
 bool BitmapOut::ToClipboard()
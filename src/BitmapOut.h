@@ -65,6 +65,20 @@ public:
    */
   wxSize ToFile(wxString file);
 
+  /*! Converts this bitmap to an image that can be saved using SaveImage()
+
+    Unlike the bitmap the image can be saved by a thread that isn't the GUI thread.
+    \return The size ToFile() would return.
+   */
+  wxSize ToImage(wxImage &image);
+
+  /*! Saves an image to a file
+
+    The file type is chosen from the file name's extension.
+    \return true, if the image could be saved.
+   */
+  static bool SaveImage(const wxImage &image, wxString file);
+
   //! Returns the bitmap representation of the list of cells that was passed to SetData()
   wxBitmap GetBitmap() const
   { return m_bmp; }
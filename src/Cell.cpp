@@ -29,6 +29,7 @@
 #include "Cell.h"
 #include <wx/regex.h>
 #include <wx/sstream.h>
+#include <string.h>
 
 wxString Cell::GetToolTip(const wxPoint &point)
 {
@@ -1522,6 +1523,9 @@ Cell::CellPointers::CellPointers(wxScrolledCanvas *mathCtrl)
   m_scrollToCell = false;
   m_cellToScrollTo = NULL;
   m_wxmxImgCounter = 0;
+  m_wxmxSaveId = 0;
+  m_wxmxReuseSaveId = 0;
+  m_nextCellID = 1;
   m_mathCtrl = mathCtrl;
   m_cellMouseSelectionStartedIn = NULL;
   m_cellKeyboardSelectionStartedIn = NULL;
@@ -1538,6 +1542,35 @@ Cell::CellPointers::CellPointers(wxScrolledCanvas *mathCtrl)
   m_currentTextCell = NULL;
 }
 
+long Cell::CellPointers::GetCellID(Cell *group)
+{
+  CellIDs::const_iterator it = m_cellIDs.find(group);
+  if (it != m_cellIDs.end())
+    return it->second;
+
+  long id = m_nextCellID++;
+  m_cellIDs[group] = id;
+  m_cellsByID[id] = group;
+  return id;
+}
+
+Cell *Cell::CellPointers::GetCellByID(long id)
+{
+  CellsByID::const_iterator it = m_cellsByID.find(id);
+  if (it == m_cellsByID.end())
+    return NULL;
+  return it->second;
+}
+
+void Cell::CellPointers::ForgetCellID(Cell *group)
+{
+  CellIDs::iterator it = m_cellIDs.find(group);
+  if (it == m_cellIDs.end())
+    return;
+  m_cellsByID.erase(it->second);
+  m_cellIDs.erase(it);
+}
+
 wxString Cell::CellPointers::WXMXGetNewFileName()
 {
   wxString file(wxT("image"));
@@ -1545,6 +1578,49 @@ wxString Cell::CellPointers::WXMXGetNewFileName()
   return file;
 }
 
+bool Cell::CellPointers::WXMXReuseEntry(long &saveId, wxString &oldName, const wxString &name)
+{
+  bool reuse = (m_wxmxReuseSaveId != 0) && (saveId == m_wxmxReuseSaveId) && (oldName == name);
+  saveId = m_wxmxSaveId;
+  oldName = name;
+  if (reuse)
+    m_wxmxReusedEntries[name] = true;
+  return reuse;
+}
+
+bool Cell::CellPointers::WXMXKnownImage(const wxMemoryBuffer &image, wxString &name)
+{
+  const unsigned char *data = (const unsigned char *) image.GetData();
+  size_t length = image.GetDataLen();
+  if (length == 0)
+    return false;
+
+  // A FNV-1a hash of the image's data
+  wxUint64 hash = wxULL(14695981039346656037);
+  for (size_t i = 0; i < length; i++)
+  {
+    hash ^= data[i];
+    hash *= wxULL(1099511628211);
+  }
+  wxString key = wxString::Format(wxT("%s:%lu:%08lx%08lx"), name.AfterLast(wxT('.')),
+                                  (unsigned long) length,
+                                  (unsigned long) (hash >> 32), (unsigned long) (hash & 0xFFFFFFFF));
+
+  std::map<wxString, std::pair<wxString, wxMemoryBuffer>>::const_iterator known = m_wxmxImages.find(key);
+  if (known == m_wxmxImages.end())
+  {
+    m_wxmxImages[key] = std::make_pair(name, image);
+    return false;
+  }
+
+  // Two different images might have the same hash.
+  if (memcmp(known->second.second.GetData(), data, length) != 0)
+    return false;
+
+  name = known->second.first;
+  return true;
+}
+
 bool Cell::CellPointers::ErrorList::Contains(Cell *cell)
 {
   for(std::list<Cell *>::const_iterator it = m_errorList.begin(); it != m_errorList.end();++it)
@@ -29,6 +29,7 @@
 #define MATHCELL_H
 
 #include <list>
+#include <map>
 #include <wx/wx.h>
 #include <wx/xml/xml.h>
 #if wxUSE_ACCESSIBILITY
@@ -139,15 +140,80 @@ class Cell
           m_lastWorkingGroup = group;
         m_workingGroup = group;
       }
+
+    /*! The number that tells maxima which group cell a command belongs to
+
+      Each group cell is assigned a number the first time one of its commands
+      is sent to maxima. Maxima echoes this number before the output of the
+      command which tells us which cell to route the output to.
+    */
+    long GetCellID(Cell *group);
+    //! The group cell GetCellID() has returned id for; NULL if it has been deleted since.
+    Cell *GetCellByID(long id);
+    //! Forget the number of a group cell that is deleted
+    void ForgetCellID(Cell *group);
     
     void WXMXResetCounter()
-      { m_wxmxImgCounter = 0; }
+      {
+        m_wxmxImgCounter = 0;
+        m_wxmxImages.clear();
+        m_wxmxWrittenEntries.clear();
+      }
     
     wxString WXMXGetNewFileName();
     
     int WXMXImageCount() const
       { return m_wxmxImgCounter; }
 
+    /*! Can an entry of the last .wxmx file be copied instead of being generated anew?
+
+      \param saveId The number of the save the entry has last been written in.
+                    Is set to the number of the current save.
+      \param oldName The name the entry has last been written with. Is set to name.
+      \param name The name the entry is written with now.
+      \retval true The worksheet will copy the entry from the last .wxmx file, the
+                   caller doesn't need to generate it.
+    */
+    bool WXMXReuseEntry(long &saveId, wxString &oldName, const wxString &name);
+
+    /*! Copy an additional entry from the last .wxmx file
+
+      Unlike WXMXReuseEntry() it is no error if the last file doesn't contain this entry.
+    */
+    void WXMXReuseOptionalEntry(const wxString &name)
+      { m_wxmxReusedEntries[name] = false; }
+
+    /*! Has an identical image already been written to the .wxmx file?
+
+      Re-evaluating a worksheet often produces plots that are identical to
+      other plots => these are stored only once.
+      \param image The image's data
+      \param name The name the image is to be written with. If an identical image
+                  has already been written this is set to the name of that image.
+      \retval true The image doesn't need to be written as name already contains it.
+    */
+    bool WXMXKnownImage(const wxMemoryBuffer &image, wxString &name);
+
+    /*! Has an additional entry of this name already been written to the .wxmx file?
+
+      Cells that share an image also share its gnuplot files.
+      \retval false The entry is now marked as written; The caller has to write it.
+    */
+    bool WXMXKnownEntry(const wxString &name)
+      {
+        if (m_wxmxWrittenEntries.find(name) != m_wxmxWrittenEntries.end())
+          return true;
+        m_wxmxWrittenEntries[name] = true;
+        return false;
+      }
+
+    //! The number of the .wxmx save that is currently in progress
+    long m_wxmxSaveId;
+    //! The number of the save whose entries can be reused, 0 = none.
+    long m_wxmxReuseSaveId;
+    //! The entries to copy from the last .wxmx file; true = the entry needs to exist
+    std::map<wxString, bool> m_wxmxReusedEntries;
+
     //! A list of editor cells containing error messages.
     class ErrorList
     {
@@ -252,6 +318,17 @@ class Cell
     WX_DECLARE_VOIDPTR_HASH_MAP( int, SlideShowTimersList);
     SlideShowTimersList m_slideShowTimers;
 
+    //! A word and the number of times it appears in the worksheet
+    typedef std::map<wxString, int> WorksheetWords;
+    /*! All words that appear in the worksheet's code cells
+
+      Every EditorCell adds the words it gains to this table and removes the
+      ones it loses whenever it is re-styled. Autocompletion therefore doesn't
+      need to traverse the whole worksheet in order to find out which words
+      it contains.
+    */
+    WorksheetWords m_worksheetWords;
+
     wxScrolledCanvas *GetMathCtrl(){return m_mathCtrl;}
 
     //! Is scrolling to a cell scheduled?
@@ -263,6 +340,18 @@ class Cell
     wxScrolledCanvas *m_mathCtrl;
     //! The image counter for saving .wxmx files
     int m_wxmxImgCounter;
+    //! The images written to the current .wxmx file, by their hash
+    std::map<wxString, std::pair<wxString, wxMemoryBuffer>> m_wxmxImages;
+    //! The additional entries written to the current .wxmx file
+    std::map<wxString, bool> m_wxmxWrittenEntries;
+    WX_DECLARE_HASH_MAP(long, Cell *, wxIntegerHash, wxIntegerEqual, CellsByID);
+    WX_DECLARE_VOIDPTR_HASH_MAP(long, CellIDs);
+    //! The group cells by the number GetCellID() has assigned to them
+    CellsByID m_cellsByID;
+    //! The numbers GetCellID() has assigned to group cells
+    CellIDs m_cellIDs;
+    //! The number GetCellID() assigns to the next cell
+    long m_nextCellID;
   };
 
 
@@ -305,6 +305,14 @@ void ConfigDialogue::SetProperties()
   m_openHCaret->SetToolTip(_("If this checkbox is set a new code cell is opened as soon as maxima requests data. If it isn't set a new code cell is opened in this case as soon as the user starts typing in code."));
   m_restartOnReEvaluation->SetToolTip(
           _("Maxima provides no \"forget all\" command that flushes all settings a maxima session could make. wxMaxima therefore normally defaults to starting a fresh maxima process every time the worksheet is to be re-evaluated. As this needs a little bit of time this switch allows to disable this behavior."));
+  m_pipelineWindow->SetToolTip(
+          _("If this number is bigger than 1 wxMaxima sends up to this many commands to maxima in one go so maxima doesn't have to wait for wxMaxima between commands. Maxima keeps these commands apart from its input so questions maxima asks are still answered by the user. Lisp commands and cells with unmatched parenthesis are only sent after the previous commands have finished. If \"Abort evaluation on error\" is set maxima skips the rest of the commands if a command fails."));
+  m_compactOutput->SetToolTip(
+          _("Makes maxima send its 2D output in a format that is shorter than XML and faster to decode. While the \"Raw XML Monitor\" is displayed maxima still sends XML."));
+  m_maximaPoolSize->SetToolTip(
+          _("The number of maxima processes that are started in the background so a restart of maxima doesn't need to wait for maxima to load. Each of these processes needs memory. Changes to the maxima binary, its parameters or the folder the worksheet is in make the spare processes useless; they are replaced automatically."));
+  m_maxUnparsedOutput->SetToolTip(
+          _("If maxima sends a single output that is bigger than this wxMaxima stops reading maxima's output, which makes maxima wait, and asks if the output is to be discarded, truncated or written to a file instead. This way a runaway command cannot make wxMaxima use up all memory."));
   m_maximaUserLocation->SetToolTip(_("Enter the path to the Maxima executable."));
   m_additionalParameters->SetToolTip(_("Additional parameters for Maxima"
                                                " (e.g. -l clisp)."));
@@ -481,6 +489,7 @@ void ConfigDialogue::SetProperties()
   m_keepPercentWithSpecials->SetValue(keepPercent);
   m_abortOnError->SetValue(configuration->GetAbortOnError());
   m_restartOnReEvaluation->SetValue(configuration->RestartOnReEvaluation());
+  m_compactOutput->SetValue(configuration->CompactOutput());
   m_defaultFramerate->SetValue(defaultFramerate);
   m_defaultPlotWidth->SetValue(defaultPlotWidth);
   m_defaultPlotHeight->SetValue(defaultPlotHeight);
@@ -989,6 +998,33 @@ wxPanel *ConfigDialogue::CreateMaximaPanel()
 
   m_restartOnReEvaluation = new wxCheckBox(panel, -1, _("Start a new maxima for each re-evaluation"));
   vsizer->Add(m_restartOnReEvaluation, 0, wxALL, 5);
+
+  wxBoxSizer *pipelineSizer = new wxBoxSizer(wxHORIZONTAL);
+  pipelineSizer->Add(new wxStaticText(panel, -1, _("Commands to send to maxima in advance:")),
+                     0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  m_pipelineWindow = new wxSpinCtrl(panel, -1, wxEmptyString, wxDefaultPosition, wxSize(150*GetContentScaleFactor(), -1), wxSP_ARROW_KEYS, 1,
+                                    100, m_configuration->PipelineWindow());
+  pipelineSizer->Add(m_pipelineWindow, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  vsizer->Add(pipelineSizer, 0, wxALL, 0);
+
+  wxBoxSizer *poolSizer = new wxBoxSizer(wxHORIZONTAL);
+  poolSizer->Add(new wxStaticText(panel, -1, _("Spare maxima processes to keep ready:")),
+                 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  m_maximaPoolSize = new wxSpinCtrl(panel, -1, wxEmptyString, wxDefaultPosition, wxSize(150*GetContentScaleFactor(), -1), wxSP_ARROW_KEYS, 0,
+                                    4, m_configuration->MaximaPoolSize());
+  poolSizer->Add(m_maximaPoolSize, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  vsizer->Add(poolSizer, 0, wxALL, 0);
+
+  wxBoxSizer *unparsedOutputSizer = new wxBoxSizer(wxHORIZONTAL);
+  unparsedOutputSizer->Add(new wxStaticText(panel, -1, _("Ask what to do with outputs longer than (million characters):")),
+                           0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  m_maxUnparsedOutput = new wxSpinCtrl(panel, -1, wxEmptyString, wxDefaultPosition, wxSize(150*GetContentScaleFactor(), -1), wxSP_ARROW_KEYS, 1,
+                                       1024, m_configuration->MaxUnparsedOutput());
+  unparsedOutputSizer->Add(m_maxUnparsedOutput, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  vsizer->Add(unparsedOutputSizer, 0, wxALL, 0);
+
+  m_compactOutput = new wxCheckBox(panel, -1, _("Use a compact format for maxima's output"));
+  vsizer->Add(m_compactOutput, 0, wxALL, 5);
   panel->SetSizerAndFit(vsizer);
 
   return panel;
@@ -1154,6 +1190,10 @@ void ConfigDialogue::WriteSettings()
   Configuration *configuration = m_configuration;
   configuration->SetAbortOnError(m_abortOnError->GetValue());
   configuration->RestartOnReEvaluation(m_restartOnReEvaluation->GetValue());
+  configuration->PipelineWindow(m_pipelineWindow->GetValue());
+  configuration->MaximaPoolSize(m_maximaPoolSize->GetValue());
+  configuration->CompactOutput(m_compactOutput->GetValue());
+  configuration->MaxUnparsedOutput(m_maxUnparsedOutput->GetValue());
   configuration->MaximaUserLocation(m_maximaUserLocation->GetValue());
   configuration->AutodetectMaxima(m_autodetectMaxima->GetValue());
   config->Write(wxT("parameters"), m_additionalParameters->GetValue());
@@ -269,6 +269,7 @@ protected:
   wxCheckBox *m_abortOnError;
   wxCheckBox *m_offerKnownAnswers;
   wxCheckBox *m_restartOnReEvaluation;
+  wxCheckBox *m_compactOutput;
   wxCheckBox *m_wrapLatexMath;
   wxCheckBox *m_savePanes;
   wxCheckBox *m_usesvg;
@@ -330,6 +331,9 @@ protected:
   wxButton *m_getMathFont;
   wxButton *m_saveStyle, *m_loadStyle;
   wxSpinCtrl *m_defaultPort;
+  wxSpinCtrl *m_pipelineWindow;
+  wxSpinCtrl *m_maximaPoolSize;
+  wxSpinCtrl *m_maxUnparsedOutput;
   ExamplePanel *m_examplePanel;
   // end wxGlade
 
@@ -74,6 +74,10 @@ Configuration::Configuration(wxDC *dc) :
   m_adjustWorksheetSizeNeeded = false;
   m_showLabelChoice = labels_prefer_user;
   m_abortOnError = true;
+  m_pipelineWindow = 1;
+  m_maximaPoolSize = 0;
+  m_compactOutput = false;
+  m_maxUnparsedOutput = 64;
   m_clientWidth = 1024;
   m_defaultPort = 40100;
 
@@ -392,6 +396,16 @@ void Configuration::ReadConfig()
   config->Read(wxT("antiAliasLines"), &m_antiAliasLines);
   config->Read(wxT("indentMaths"), &m_indentMaths);
   config->Read(wxT("abortOnError"),&m_abortOnError);
+  config->Read(wxT("pipelineWindow"),&m_pipelineWindow);
+  if(m_pipelineWindow < 1)
+    m_pipelineWindow = 1;
+  config->Read(wxT("maximaPoolSize"),&m_maximaPoolSize);
+  if(m_maximaPoolSize < 0)
+    m_maximaPoolSize = 0;
+  config->Read(wxT("compactOutput"),&m_compactOutput);
+  config->Read(wxT("maxUnparsedOutput"),&m_maxUnparsedOutput);
+  if(m_maxUnparsedOutput < 1)
+    m_maxUnparsedOutput = 1;
   config->Read("defaultPort",&m_defaultPort);
   config->Read(wxT("fixReorderedIndices"), &m_fixReorderedIndices);
   config->Read(wxT("showLength"), &m_showLength);
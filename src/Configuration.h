@@ -803,6 +803,41 @@ public:
   void SetAbortOnError(bool abortOnError)
     {wxConfig::Get()->Write("abortOnError",m_abortOnError = abortOnError);}
 
+  /*! How many commands we may send to maxima before it has finished the first of them
+
+    1 means: Send the next command only after maxima has finished the last one.
+   */
+  int PipelineWindow() const {return m_pipelineWindow;}
+  void PipelineWindow(int window)
+    {wxConfig::Get()->Write("pipelineWindow",m_pipelineWindow = window);}
+
+  /*! How many maxima processes to keep running in the background
+
+    A restart of maxima then can use one of these processes instead of having
+    to wait for a new maxima to load. 0 means: Don't start spare processes.
+   */
+  int MaximaPoolSize() const {return m_maximaPoolSize;}
+  void MaximaPoolSize(int size)
+    {wxConfig::Get()->Write("maximaPoolSize",m_maximaPoolSize = size);}
+
+  /*! Does maxima send its 2D output in the compact format instead of as XML?
+
+    The compact format is shorter and faster to decode, see
+    MathParser::DecodeCompactXml().
+   */
+  bool CompactOutput() const {return m_compactOutput;}
+  void CompactOutput(bool compact)
+    {wxConfig::Get()->Write("compactOutput",m_compactOutput = compact);}
+
+  /*! How many million characters of output maxima may send before it can be displayed
+
+    If a single output exceeds this size wxMaxima stops reading from maxima
+    and asks the user what to do with the rest of the output.
+   */
+  int MaxUnparsedOutput() const {return m_maxUnparsedOutput;}
+  void MaxUnparsedOutput(int millions)
+    {wxConfig::Get()->Write("maxUnparsedOutput",m_maxUnparsedOutput = millions);}
+
   bool OfferKnownAnswers() const {return m_offerKnownAnswers;}
   void OfferKnownAnswers(bool offerKnownAnswers)
     {wxConfig::Get()->Write("offerKnownAnswers",m_offerKnownAnswers = offerKnownAnswers);}
@@ -952,6 +987,10 @@ private:
   bool m_useUnicodeMaths;
   bool m_indentMaths;
   bool m_abortOnError;
+  int m_pipelineWindow;
+  int m_maximaPoolSize;
+  bool m_compactOutput;
+  int m_maxUnparsedOutput;
   bool m_hidemultiplicationsign;
   bool m_offerKnownAnswers;
   int m_defaultPort;
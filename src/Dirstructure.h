@@ -81,6 +81,14 @@ public:
   wxString UserAutocompleteFile() const
   { return UserConfDir() + wxT(".wxmaxima.ac"); }
 
+#endif
+
+  //! The file the list of files in maxima's share dir is cached in
+#if defined __WXMSW__
+  wxString UserSymbolCacheFile() const {return UserConfDir()+wxT("wxmax.sc");}
+#else
+  wxString UserSymbolCacheFile() const
+  { return UserConfDir() + wxT(".wxmaxima.symbolcache"); }
 #endif
 
   //! The path to wxMaxima's own AutoComplete file
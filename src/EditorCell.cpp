@@ -68,6 +68,9 @@ EditorCell::EditorCell(Cell *parent, Configuration **config,
   m_containsChangesCheck = false;
   m_firstLineOnly = false;
   m_historyPosition = -1;
+  m_wordListRegistered = false;
+  m_parenthesisStateIndex = -1;
+  m_parenthesisStateLispMode = false;
   SetValue(TabExpand(text, 0));
 //  ResetSize();  
 }
@@ -402,6 +405,11 @@ void EditorCell::MarkAsDeleted()
   if (m_cellPointers->m_activeCell == this)
     m_cellPointers->m_activeCell = NULL;
 
+  // Remove our words from the list of words the worksheet contains
+  if (m_wordListRegistered)
+    UpdateWorksheetWords(m_wordList, wxArrayString());
+  m_wordListRegistered = false;
+
   Cell::MarkAsDeleted();
 }
 
@@ -2387,145 +2395,261 @@ bool EditorCell::HandleOrdinaryKey(wxKeyEvent &event)
   return true;
 }
 
-/**
- * For a given quotation mark ("), find a matching quote.
- * Since there are no nested quotes, an odd-numbered, non-escaped quote
- * is an opening quote, and an even-numbered non-escaped quote
- * is a closing quote.
- *
- * @return true if matching quotation marks were found; false otherwise
- */
-bool EditorCell::FindMatchingQuotes()
+void EditorCell::IndexBrackets(const MaximaTokenizer::TokenList &tokens)
 {
-  int pos = m_positionOfCaret;
-  if (pos < 0)
-  {
-    m_paren1 = m_paren2 = -1;
-    return false;
-  }
+  m_bracketIndexText = m_text;
+  m_matchingBracket.clear();
 
-  if(pos >= (long)m_text.Length())
-    pos = m_text.Length()-1;
-  if ((pos >= (long) m_text.Length() - 1)||
-      (wxString(wxT("\"")).Find(m_text.GetChar(pos)) == -1))
+  // Parenthesis are only matched with parenthesis of the same type.
+  std::vector<long> openParens;
+  std::vector<long> openBrackets;
+  std::vector<long> openBraces;
+
+  // In code quotes and parenthesis that are part of strings or comments
+  // don't count.
+  long pos = 0;
+  for (MaximaTokenizer::TokenList::const_iterator it = tokens.begin(); it != tokens.end(); ++it)
   {
-    pos--;
-    if (pos < 0 ||
-        wxString(wxT("\"")).Find(m_text.GetChar(pos)) == -1)
+    wxString tokenText = (*it)->GetText();
+    long length = tokenText.Length();
+    if (length == 0)
+      continue;
+
+    if ((*it)->GetStyle() == TS_CODE_STRING)
     {
-      m_paren1 = m_paren2 = -1;
-      return false;
+      if ((length > 1) && tokenText.EndsWith(wxT("\"")))
+      {
+        m_matchingBracket[pos] = pos + length - 1;
+        m_matchingBracket[pos + length - 1] = pos;
+      }
     }
+    else if ((length == 1) && ((*it)->GetStyle() != TS_CODE_COMMENT))
+      IndexBracket(tokenText[0], pos, openParens, openBrackets, openBraces);
+    pos += length;
   }
+}
 
-  int count = 0;
-  for (int i = 0; i < (int) m_text.Length(); ++i)
+void EditorCell::IndexBrackets()
+{
+  if (m_bracketIndexText == m_text)
+    return;
+
+  m_bracketIndexText = m_text;
+  m_matchingBracket.clear();
+
+  // Parenthesis are only matched with parenthesis of the same type.
+  std::vector<long> openParens;
+  std::vector<long> openBrackets;
+  std::vector<long> openBraces;
+
+  long openQuote = -1;
+  for (long pos = 0; pos < (long) m_text.Length(); ++pos)
   {
-    if (m_text.GetChar(i) == '"' &&
-        ((i == 0) ||
-         (i >= 1 && m_text.GetChar(i - 1) != '\\')))
+    wxChar ch = m_text[pos];
+    if ((ch == wxT('"')) && ((pos == 0) || (m_text[pos - 1] != wxT('\\'))))
     {
-      ++count;
-      if (count & 1)
-      {
-        m_paren1 = i;  // open quote here
-      }
+      if (openQuote < 0)
+        openQuote = pos;
       else
       {
-        m_paren2 = i;  // close quote here
-        if (m_paren1 == pos || m_paren2 == pos)
-        {
-          // found the pair of quotes under the cursor
-          return true;
-        }
+        m_matchingBracket[openQuote] = pos;
+        m_matchingBracket[pos] = openQuote;
+        openQuote = -1;
       }
     }
+    else
+      IndexBracket(ch, pos, openParens, openBrackets, openBraces);
   }
-
-  // didn't find matching quotes; do not highlight quotes
-  m_paren1 = m_paren2 = -1;
-  return false;
 }
 
-void EditorCell::FindMatchingParens()
+void EditorCell::IndexBracket(wxChar ch, long pos, std::vector<long> &openParens,
+                              std::vector<long> &openBrackets, std::vector<long> &openBraces)
 {
-  if (FindMatchingQuotes())
+  std::vector<long> *openList;
+  bool opening = false;
+  switch (ch)
   {
+  case '(':
+    opening = true;
+    // fallthrough
+  case ')':
+    openList = &openParens;
+    break;
+  case '[':
+    opening = true;
+    // fallthrough
+  case ']':
+    openList = &openBrackets;
+    break;
+  case '{':
+    opening = true;
+    // fallthrough
+  case '}':
+    openList = &openBraces;
+    break;
+  default:
     return;
   }
 
-  m_paren2 = m_positionOfCaret;
-  if (m_paren2 < 0)
+  if (opening)
+    openList->push_back(pos);
+  else if (!openList->empty())
   {
-    m_paren1 = m_paren2 = -1;
-    return;
+    m_matchingBracket[pos] = openList->back();
+    m_matchingBracket[openList->back()] = pos;
+    openList->pop_back();
   }
+}
+
+void EditorCell::FindMatchingParens()
+{
+  m_paren1 = m_paren2 = -1;
+  long length = m_text.Length();
+  if ((m_positionOfCaret < 0) || (length == 0))
+    return;
 
-  if(m_paren2 >= (long)m_text.Length())
-    m_paren2 = m_text.Length() - 1;
-  if ((m_paren2 >= (long) m_text.Length())||
-      (wxString(wxT("([{}])")).Find(m_text.GetChar(m_paren2)) == -1))
+  if (m_type == MC_TYPE_INPUT)
   {
-    m_paren2--;
-    if (m_paren2 < 0 ||
-        wxString(wxT("([{}])")).Find(m_text.GetChar(m_paren2)) == -1)
-    {
-      m_paren1 = m_paren2 = -1;
+    // Code cells get their index from StyleTextCode() that calls us again
+    // as soon as the index matches the text.
+    if (m_bracketIndexText != m_text)
       return;
-    }
   }
+  else
+    IndexBrackets();
+
+  // The caret can be directly in front of or directly after a parenthesis
+  // or quote.
+  long pos = wxMin(m_positionOfCaret, length - 1);
+  BracketIndex::const_iterator it = m_matchingBracket.find(pos);
+  if ((it == m_matchingBracket.end()) && (pos > 0))
+    it = m_matchingBracket.find(pos - 1);
+  if (it == m_matchingBracket.end())
+    return;
 
-  wxChar first = m_text.GetChar(m_paren2);
-  wxChar second;
-  int dir;
+  m_paren2 = it->first;
+  m_paren1 = it->second;
+}
 
-  switch (first)
+wxString EditorCell::GetUnmatchedParenthesisState(int &index)
+{
+  wxString text = ToString(true);
+  bool lispMode = (*m_configuration)->InLispMode();
+  if ((text != m_parenthesisStateText) || (lispMode != m_parenthesisStateLispMode) ||
+      (m_parenthesisStateIndex < 0))
   {
-    case '(':
-      second = ')';
-      dir = 1;
-      break;
-    case '[':
-      second = ']';
-      dir = 1;
-      break;
-    case '{':
-      second = '}';
-      dir = 1;
-      break;
-    case ')':
-      second = '(';
-      dir = -1;
-      break;
-    case ']':
-      second = '[';
-      dir = -1;
-      break;
-    case '}':
-      second = '{';
-      dir = -1;
-      break;
-    default:
-      return;
+    m_parenthesisStateIndex = 0;
+    m_parenthesisState = GetUnmatchedParenthesisState(text, *m_configuration,
+                                                      m_parenthesisStateIndex);
+    m_parenthesisStateText = text;
+    m_parenthesisStateLispMode = lispMode;
   }
+  index = m_parenthesisStateIndex;
+  return m_parenthesisState;
+}
+
+wxString EditorCell::GetUnmatchedParenthesisState(wxString text, Configuration *configuration,
+                                                  int &index)
+{
+  text.Trim(true);
+  text.Trim(false);
+  if(text == wxEmptyString)
+    return (wxEmptyString);
+  if (text.EndsWith(wxT("\\")))
+    return (_("Cell ends in a backslash"));
 
-  m_paren1 = m_paren2 + dir;
-  int depth = 1;
+  MaximaTokenizer::TokenList tokens =
+    MaximaTokenizer(text, configuration).GetTokens();
 
-  while (m_paren1 >= 0 && m_paren1 < (int) m_text.Length())
+  index = 0;
+  bool endingNeeded = true;
+  wxChar lastnonWhitespace;
+  wxChar lastnonWhitespace_Next = wxT(' ');
+  MaximaTokenizer::TokenList::const_iterator it;
+  std::list<wxChar> delimiters;
+  for (it = tokens.begin(); it != tokens.end(); ++it)
   {
-    if (m_text.GetChar(m_paren1) == second)
-      depth--;
-    else if (m_text.GetChar(m_paren1) == first)
-      depth++;
+    wxString itemText = (*it)->GetText();
+    TextStyle itemStyle = (*it)->GetStyle();
+    index += itemText.Length();
 
-    if (depth == 0)
-      break;
-    m_paren1 += dir;
+    lastnonWhitespace = lastnonWhitespace_Next;
+
+    // Handle comments
+    if(itemStyle == TS_CODE_COMMENT)
+    {
+      if(!itemText.EndsWith("*/"))
+        return (_("Unterminated comment."));
+      continue;
+    }
+
+    wxChar firstC = itemText[0];
+    wxChar lastC = itemText.Last();
+
+    // Remember the last non-whitespace character that isn't part
+    // of a comment.
+    if((firstC != ' ') && (firstC != '\t') && (firstC != '\r') && (firstC != '\n'))
+      lastnonWhitespace_Next = lastC;
+
+    // Handle opening parenthesis
+    if(itemText == "(")
+    {
+      delimiters.push_back(wxT(')'));
+      continue;
+    }
+    if(itemText == "[")
+    {
+      delimiters.push_back(wxT(']'));
+      continue;
+    }
+    if(itemText == "{")
+    {
+      delimiters.push_back(wxT('}'));
+      continue;
+    }
+
+    // Handle closing parenthesis
+    if((itemText == ')') || (itemText == ']') || (itemText == '}'))
+    {
+      endingNeeded = true;
+      if (delimiters.empty()) return (_("Mismatched parenthesis"));
+      if (firstC != delimiters.back()) return (_("Mismatched parenthesis"));
+      delimiters.pop_back();
+      if (lastnonWhitespace == wxT(','))
+        return (_("Comma directly followed by a closing parenthesis"));
+      continue;
+    }
+
+    if(itemStyle == TS_CODE_STRING)
+    {
+      endingNeeded = true;
+      if(!itemText.EndsWith("\""))
+        return (_("Unterminated string."));
+      continue;
+    }
+
+    if(itemStyle == TS_CODE_ENDOFLINE)
+    {
+      if(!delimiters.empty())
+        return _("Un-closed parenthesis on encountering ; or $");
+      endingNeeded = false;
+      continue;
+    }
+
+    if((*it)->GetStyle() == TS_CODE_LISP)
+    {
+      endingNeeded = false;
+      continue;
+    }
   }
 
-  if (m_paren1 < 0 || m_paren1 >= (int) m_text.Length())
-    m_paren1 = m_paren2 = -1;
+  if (!delimiters.empty())
+    return _("Un-closed parenthesis");
+
+  if((endingNeeded) && (!configuration->InLispMode()))
+    return _("No dollar ($) or semicolon (;) at the end of command");
+  else
+    return wxEmptyString;
 }
 
 wxString EditorCell::InterpretEscapeString(wxString txt) const
@@ -3434,6 +3558,20 @@ void EditorCell::StyleTextCode()
   // Split the line into commands, numbers etc.
   m_tokens = MaximaTokenizer(textToStyle, *m_configuration).GetTokens();
 
+  // The tokens tell which parenthesis and quotes belong together. A folded
+  // cell's tokens don't describe the whole text, though.
+  if (textToStyle == m_text)
+  {
+    IndexBrackets(m_tokens);
+    if (IsActive())
+      FindMatchingParens();
+  }
+  else
+  {
+    m_bracketIndexText = wxEmptyString;
+    m_matchingBracket.clear();
+  }
+
   // Now handle the text pieces one by one
   wxString lastTokenWithText;
   int pos = 0;
@@ -3800,12 +3938,15 @@ void EditorCell::StyleText()
   // the font type and size.
   SetFont();
 
-
+  wxArrayString oldWordList = m_wordList;
   m_wordList.Clear();
   m_styledText.clear();
 
   if(m_text == wxEmptyString)
+  {
+    UpdateWorksheetWords(oldWordList);
     return;
+  }
 
   // Remove all soft line breaks. They will be re-added in the right places
   // in the next step
@@ -3815,6 +3956,60 @@ void EditorCell::StyleText()
     StyleTextCode();
   else
     StyleTextTexts();
+  UpdateWorksheetWords(oldWordList);
+}
+
+void EditorCell::RegisterWordList()
+{
+  if (!m_wordListRegistered)
+    UpdateWorksheetWords(wxArrayString(), m_wordList);
+  m_wordListRegistered = true;
+}
+
+void EditorCell::UpdateWorksheetWords(const wxArrayString &oldWordList)
+{
+  // Cells that aren't part of the worksheet (yet) don't count their words,
+  // see RegisterWordList().
+  if (m_wordListRegistered)
+    UpdateWorksheetWords(oldWordList, m_wordList);
+}
+
+void EditorCell::UpdateWorksheetWords(const wxArrayString &oldWordList, const wxArrayString &newWordList)
+{
+  Cell::CellPointers::WorksheetWords &words = m_cellPointers->m_worksheetWords;
+
+  // Both lists are sorted => We can walk through them in parallel and only
+  // need to touch the words that actually have changed.
+  size_t oldIndex = 0;
+  size_t newIndex = 0;
+  while ((oldIndex < oldWordList.GetCount()) || (newIndex < newWordList.GetCount()))
+  {
+    if ((newIndex >= newWordList.GetCount()) ||
+        ((oldIndex < oldWordList.GetCount()) && (oldWordList[oldIndex] < newWordList[newIndex])))
+    {
+      // A word we have lost
+      Cell::CellPointers::WorksheetWords::iterator it = words.find(oldWordList[oldIndex]);
+      if (it != words.end())
+      {
+        if (--it->second <= 0)
+          words.erase(it);
+      }
+      oldIndex++;
+    }
+    else if ((oldIndex >= oldWordList.GetCount()) ||
+             (newWordList[newIndex] < oldWordList[oldIndex]))
+    {
+      // A word we have gained
+      words[newWordList[newIndex]]++;
+      newIndex++;
+    }
+    else
+    {
+      // A word that hasn't changed
+      oldIndex++;
+      newIndex++;
+    }
+  }
 }
 
 
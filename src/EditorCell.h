@@ -74,6 +74,19 @@ private:
   //! A list of all potential autoComplete targets within this cell
   wxArrayString m_wordList;
 
+  //! Are the words in m_wordList counted in the worksheet's word table?
+  bool m_wordListRegistered;
+
+  //! Update the worksheet's word table after m_wordList has been re-generated
+  void UpdateWorksheetWords(const wxArrayString &oldWordList);
+
+  /*! Tell the worksheet's word table which words this cell has gained or lost
+
+    \param oldWordList The sorted list of words that is counted in the table
+    \param newWordList The sorted list of words that is to be counted instead
+  */
+  void UpdateWorksheetWords(const wxArrayString &oldWordList, const wxArrayString &newWordList);
+
   //! Draw a box that marks the current selection
   void MarkSelection(long start, long end, TextStyle style, int fontsize);
 
@@ -103,6 +116,15 @@ public:
   Cell *Copy() override {return new EditorCell(*this);}
   ~EditorCell();
 
+  /*! Add this cell's words to the worksheet's word table
+
+    Called when the cell is inserted into the worksheet, see
+    Worksheet::RegisterWordLists(). Until then, and after the cell has been
+    marked as deleted, its words aren't counted: Copies of cells in the undo
+    buffer or the clipboard mustn't keep words in the autocompletion.
+  */
+  void RegisterWordList();
+
   //! Insert the symbol that corresponds to the ESC command txt
   void InsertEscCommand(wxString txt){InsertText(InterpretEscapeString(txt));}
 
@@ -373,10 +395,24 @@ public:
     return m_selectionStart != -1;
   }
 
-  bool FindMatchingQuotes();
-
+  //! Find the parenthesis or quote that matches the one next to the cursor
   void FindMatchingParens();
 
+  /*! Returns an error message if the code in this cell isn't ready to be sent to maxima
+
+    The result is cached until the cell's contents change.
+    \param index The position the error was found at
+   */
+  wxString GetUnmatchedParenthesisState(int &index);
+
+  /*! Returns an error message if a string of maxima code isn't ready to be sent to maxima
+
+    \param text The code to check
+    \param configuration The configuration that tells the tokenizer how to split text into tokens
+    \param index The position the error was found at
+   */
+  static wxString GetUnmatchedParenthesisState(wxString text, Configuration *configuration, int &index);
+
   int GetLineWidth(unsigned int line, int pos);
 
   //! true, if this cell's width has to be recalculated.
@@ -728,6 +764,26 @@ private:
   StringHash m_widths;
   int m_charHeight;
   int m_paren1, m_paren2;
+  WX_DECLARE_HASH_MAP(long, long, wxIntegerHash, wxIntegerEqual, BracketIndex);
+  //! For every parenthesis and quote in m_bracketIndexText: The position of its counterpart
+  BracketIndex m_matchingBracket;
+  //! The text m_matchingBracket has been generated for
+  wxString m_bracketIndexText;
+  //! Update m_matchingBracket of a text cell if the text has changed since it was generated
+  void IndexBrackets();
+  //! Generate m_matchingBracket of a code cell from the tokens of its whole text
+  void IndexBrackets(const MaximaTokenizer::TokenList &tokens);
+  //! Add a parenthesis to m_matchingBracket, if it is one.
+  void IndexBracket(wxChar ch, long pos, std::vector<long> &openParens,
+                    std::vector<long> &openBrackets, std::vector<long> &openBraces);
+  //! The cached result of GetUnmatchedParenthesisState()
+  wxString m_parenthesisState;
+  //! The error position for m_parenthesisState; -1 = not yet calculated
+  int m_parenthesisStateIndex;
+  //! The text m_parenthesisState has been generated for
+  wxString m_parenthesisStateText;
+  //! Was maxima in lisp mode when m_parenthesisState was generated?
+  bool m_parenthesisStateLispMode;
   //! Does this cell's size have to be recalculated?
   bool m_isDirty;
   bool m_displayCaret;
@@ -29,6 +29,7 @@
 
 #include "EvaluationQueue.h"
 #include "MaximaTokenizer.h"
+#include <iterator>
 
 bool EvaluationQueue::Empty() const
 {
@@ -38,6 +39,7 @@ bool EvaluationQueue::Empty() const
 EvaluationQueue::EvaluationQueue()
 {
   m_size = 0;
+  m_queuedCommandsInFlight = 0;
   m_workingGroupChanged = false;
 }
 
@@ -47,6 +49,10 @@ void EvaluationQueue::Clear()
   m_size = 0;
   m_commands.clear();
   m_workingGroupChanged = false;
+  // Maxima will still send us a prompt for every command it works on.
+  for(std::list<GroupCell *>::iterator it = m_commandsInFlight.begin(); it != m_commandsInFlight.end(); ++it)
+    *it = NULL;
+  m_queuedCommandsInFlight = 0;
 }
 
 bool EvaluationQueue::IsInQueue(GroupCell *gr) const
@@ -63,11 +69,17 @@ void EvaluationQueue::Remove(GroupCell *gr)
   bool removeFirst = !(m_queue.empty()) && gr == m_queue.front();
   m_queue.remove(gr);
   m_size = m_queue.size();
+  for(std::list<GroupCell *>::iterator it = m_commandsInFlight.begin(); it != m_commandsInFlight.end(); ++it)
+    if (*it == gr)
+    {
+      *it = NULL;
+      m_queuedCommandsInFlight--;
+    }
   if(removeFirst)
   {
     m_commands.clear();
     if(!m_queue.empty())
-      AddTokens(gr);
+      AddTokens(GetCell());
   }
 }
 
@@ -128,7 +140,7 @@ void EvaluationQueue::RemoveFirst()
   }
 }
 
-void EvaluationQueue::AddTokens(GroupCell *cell)
+void EvaluationQueue::AddTokens(GroupCell *cell, std::list<EvaluationQueue::command> &commands)
 {
   if(cell == NULL)
     return;
@@ -150,7 +162,7 @@ void EvaluationQueue::AddTokens(GroupCell *cell)
       token.Trim(true);
       token.Trim(false);
       if(!token.IsEmpty())
-        m_commands.push_back(command(token, index));      
+        commands.push_back(command(token, index));      
       token = wxEmptyString;
       continue;
     }
@@ -160,7 +172,7 @@ void EvaluationQueue::AddTokens(GroupCell *cell)
       token.Trim(true);
       token.Trim(false);
       if(!token.IsEmpty())
-        m_commands.push_back(command(token, index));
+        commands.push_back(command(token, index));
       token = wxEmptyString;
       continue;
     }
@@ -168,7 +180,7 @@ void EvaluationQueue::AddTokens(GroupCell *cell)
   token.Trim(true);
   token.Trim(false);
   if(!token.IsEmpty())
-    m_commands.push_back(command(token, index));
+    commands.push_back(command(token, index));
 }
 
 GroupCell *EvaluationQueue::GetCell()
@@ -216,3 +228,50 @@ wxString EvaluationQueue::GetCommand()
   return retval;
 }
 
+wxString EvaluationQueue::GetCommand(size_t n, GroupCell *&cell) const
+{
+  cell = NULL;
+  if(m_queue.empty())
+    return wxEmptyString;
+
+  std::list<GroupCell *>::const_iterator it = m_queue.begin();
+  std::list<EvaluationQueue::command> commands = m_commands;
+  while (n >= commands.size())
+  {
+    n -= commands.size();
+    if(++it == m_queue.end())
+      return wxEmptyString;
+    commands.clear();
+    AddTokens(*it, commands);
+  }
+  cell = *it;
+  std::list<EvaluationQueue::command>::const_iterator cmd = commands.begin();
+  std::advance(cmd, n);
+  return cmd->GetString();
+}
+
+void EvaluationQueue::CommandSent(GroupCell *cell)
+{
+  m_commandsInFlight.push_back(cell);
+  m_queuedCommandsInFlight++;
+}
+
+bool EvaluationQueue::CommandFinished()
+{
+  // If we don't keep track of the commands we have sent all prompts are for
+  // the first command in the queue.
+  if (m_commandsInFlight.empty())
+    return true;
+
+  bool queued = (m_commandsInFlight.front() != NULL);
+  m_commandsInFlight.pop_front();
+  if (queued)
+    m_queuedCommandsInFlight--;
+  return queued;
+}
+
+void EvaluationQueue::ClearCommandsInFlight()
+{
+  m_commandsInFlight.clear();
+  m_queuedCommandsInFlight = 0;
+}
@@ -67,7 +67,20 @@ private:
   std::list<GroupCell *>m_queue;
 
   //! Adds all commands in commandString as separate tokens to the queue.
-  void AddTokens(GroupCell *cell);
+  void AddTokens(GroupCell *cell){AddTokens(cell, m_commands);}
+  //! Splits the contents of cell into separate commands and appends them to commands.
+  static void AddTokens(GroupCell *cell, std::list<EvaluationQueue::command> &commands);
+
+  /*! The cells the commands we have sent to maxima, but haven't got a prompt for, belong to
+
+    This list is only maintained if we send commands to maxima before the
+    previous one has finished: In this case it tells us which cell a prompt
+    belongs to. A NULL entry means that the cell has left the queue after the
+    command was sent.
+   */
+  std::list<GroupCell *> m_commandsInFlight;
+  //! The number of non-NULL entries in m_commandsInFlight
+  size_t m_queuedCommandsInFlight;
 
   //! A list of answers provided by the user
   wxArrayString m_knownAnswers;
@@ -143,6 +156,44 @@ public:
   //! Return the next command that needs to be evaluated.
   wxString GetCommand();  
 
+  /*! Return the nth command that needs to be evaluated
+
+    n=0 is the command GetCommand() returns.
+    \param n The number of the command
+    \param cell Is set to the cell the command belongs to, or NULL if the queue
+                doesn't contain that many commands.
+  */
+  wxString GetCommand(size_t n, GroupCell *&cell) const;
+
+  //! Remember that we have sent the first command of cell that we hadn't sent, yet.
+  void CommandSent(GroupCell *cell);
+
+  /*! Maxima has finished the oldest command we remembered with CommandSent()
+
+    \return false, if this command has left the queue since we have sent it:
+    In this case the queue isn't affected by the command having finished.
+   */
+  bool CommandFinished();
+
+  //! Forget about all commands maxima works on, for example since it has been restarted.
+  void ClearCommandsInFlight();
+
+  //! The number of commands we have sent to maxima and haven't got a prompt for
+  size_t CommandsInFlight() const
+  { return m_commandsInFlight.size(); }
+
+  //! The number of commands in the queue we have sent to maxima already
+  size_t QueuedCommandsInFlight() const
+  { return m_queuedCommandsInFlight; }
+
+  //! Have we already sent the command GetCommand() returns?
+  bool CommandInFlight() const
+  { return m_queuedCommandsInFlight > 0; }
+
+  //! Is the command maxima works on one that has left the queue after we have sent it?
+  bool LeftQueueCommandInFlight() const
+  { return (!m_commandsInFlight.empty()) && (m_commandsInFlight.front() == NULL); }
+
   //! Get the size of the queue [in cells]
   int Size() const
   {
@@ -433,6 +433,7 @@ void GroupCell::MarkAsDeleted()
   if((m_cellPointers->m_answerCell) &&(m_cellPointers->m_answerCell->GetGroup() == this))
     m_cellPointers->m_answerCell = NULL;
   m_cellPointers->m_errorList.Remove(this);
+  m_cellPointers->ForgetCellID(this);
   if (this == m_cellPointers->m_workingGroup)
     m_cellPointers->m_workingGroup = NULL;
   if (this == m_cellPointers->m_lastWorkingGroup)
@@ -1447,7 +1448,8 @@ wxString GroupCell::ToRTF()
   return retval;
 }
 
-wxString GroupCell::ToTeX(wxString imgDir, wxString filename, int *imgCounter)
+wxString GroupCell::ToTeX(wxString imgDir, wxString filename, int *imgCounter,
+                          ParallelImageWriter *imageWriter)
 {
   wxASSERT_MSG((imgCounter != NULL), _(wxT("Bug: No image counter to write to!")));
   if (imgCounter == NULL) return wxEmptyString;
@@ -1484,7 +1486,7 @@ wxString GroupCell::ToTeX(wxString imgDir, wxString filename, int *imgCounter)
       break;
 
     case GC_TYPE_CODE:
-      str = ToTeXCodeCell(imgDir, filename, imgCounter);
+      str = ToTeXCodeCell(imgDir, filename, imgCounter, imageWriter);
       str.Replace(wxT("\\[\\displaystyle \\]"),wxT(""));
       break;
 
@@ -1534,7 +1536,8 @@ wxString GroupCell::ToTeX(wxString imgDir, wxString filename, int *imgCounter)
   return str;
 }
 
-wxString GroupCell::ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCounter)
+wxString GroupCell::ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCounter,
+                                  ParallelImageWriter *imageWriter)
 {
   wxString str;
   Configuration *configuration = (*m_configuration);
@@ -1573,7 +1576,7 @@ wxString GroupCell::ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCo
       if (tmp->GetType() == MC_TYPE_IMAGE ||
           tmp->GetType() == MC_TYPE_SLIDE)
       {
-        str << ToTeXImage(tmp, imgDir, filename, imgCounter);
+        str << ToTeXImage(tmp, imgDir, filename, imgCounter, imageWriter);
       }
       else
       {
@@ -1628,7 +1631,8 @@ wxString GroupCell::ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCo
   return str;
 }
 
-wxString GroupCell::ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, int *imgCounter)
+wxString GroupCell::ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, int *imgCounter,
+                               ParallelImageWriter *imageWriter)
 {
   wxASSERT_MSG((imgCounter != NULL), _("Bug: No image counter to write to!"));
   if (imgCounter == NULL) return wxEmptyString;
@@ -1637,7 +1641,7 @@ wxString GroupCell::ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, in
 
   if (imgDir != wxEmptyString)
   {
-    Cell *copy = tmp->Copy();
+    std::unique_ptr<Cell> copy(tmp->Copy());
     (*imgCounter)++;
     wxString image = filename + wxString::Format(wxT("_%d"), *imgCounter);
     if (!wxDirExists(imgDir))
@@ -1654,7 +1658,16 @@ wxString GroupCell::ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, in
       for (int i = 0; i < src->Length(); i++)
       {
         wxString Frame = imgDir + wxT("/") + image + wxString::Format(wxT("_%i"), i);
-        if ((src->GetBitmap(i)).SaveFile(Frame + wxT(".png")))
+        if (imageWriter != NULL)
+        {
+          // Encoding the frame as png doesn't need the GUI thread => let the
+          // image writer's threads do that while we continue exporting.
+          wxImage frame = src->GetBitmap(i).ConvertToImage();
+          imageWriter->Add(frame, Frame + wxT(".png"));
+          str << wxT("\\includegraphics[width=.95\\linewidth,height=.80\\textheight,keepaspectratio]{") + Frame +
+                 wxT("}\n");
+        }
+        else if ((src->GetBitmap(i)).SaveFile(Frame + wxT(".png")))
           str << wxT("\\includegraphics[width=.95\\linewidth,height=.80\\textheight,keepaspectratio]{") + Frame +
                  wxT("}\n");
         else
@@ -1666,8 +1679,8 @@ wxString GroupCell::ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, in
     }
     else
     {
-      wxString file = imgDir + wxT("/") + image + wxT(".") + dynamic_cast<ImgCell *>(copy)->GetExtension();
-      if (dynamic_cast<ImgCell *>(copy)->ToImageFile(file).x >= 0)
+      wxString file = imgDir + wxT("/") + image + wxT(".") + dynamic_cast<ImgCell *>(copy.get())->GetExtension();
+      if (dynamic_cast<ImgCell *>(copy.get())->ToImageFile(file).x >= 0)
         str += wxT("\\includegraphics[width=.95\\linewidth,height=.80\\textheight,keepaspectratio]{") +
                filename + wxT("_img/") + image + wxT("}");
       else
@@ -32,6 +32,7 @@
 
 #include "Cell.h"
 #include "EditorCell.h"
+#include "ParallelImageWriter.h"
 
 #define EMPTY_INPUT_LABEL wxT(" -->  ")
 
@@ -181,7 +182,16 @@ public:
   //! GroupCells warn if they contain both greek and latin lookalike chars.
   void UpdateConfusableCharWarnings();
   
-  wxString ToTeX(wxString imgDir, wxString filename, int *imgCounter);
+  /*! Convert the current cell to TeX
+
+    \param imgDir The directory images are written to
+    \param filename The name of the .tex file without extension
+    \param imgCounter The number of the last image that was written
+    \param imageWriter If this isn't NULL the images that need to be encoded
+           first are written by this object's threads in the background.
+   */
+  wxString ToTeX(wxString imgDir, wxString filename, int *imgCounter,
+                 ParallelImageWriter *imageWriter = NULL);
 
   /*! Convert the current cell to its wxm representation.
 
@@ -193,9 +203,11 @@ public:
 
   wxString ToRTF() override;
 
-  wxString ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCounter);
+  wxString ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCounter,
+                         ParallelImageWriter *imageWriter = NULL);
 
-  static wxString ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, int *imgCounter);
+  static wxString ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, int *imgCounter,
+                             ParallelImageWriter *imageWriter = NULL);
 
   wxString ToTeX() override;
 
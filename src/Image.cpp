@@ -33,6 +33,7 @@
 #include <wx/txtstrm.h>
 #include <wx/regex.h>
 #include <wx/stdpaths.h>
+#include <string.h>
 #include "SvgBitmap.h"
 
 wxMemoryBuffer Image::ReadCompressedImage(wxInputStream *data)
@@ -52,6 +53,71 @@ wxMemoryBuffer Image::ReadCompressedImage(wxInputStream *data)
   return retval;
 }
 
+bool Image::ReadImageSize(const wxMemoryBuffer &image, int &width, int &height)
+{
+  const unsigned char *data = (const unsigned char *) image.GetData();
+  size_t length = image.GetDataLen();
+
+  // png: The IHDR chunk that contains the size always directly follows the
+  // signature.
+  static const unsigned char pngSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  if ((length >= 24) && (memcmp(data, pngSignature, 8) == 0) &&
+      (memcmp(data + 12, "IHDR", 4) == 0))
+  {
+    width = (data[16] << 24) | (data[17] << 16) | (data[18] << 8) | data[19];
+    height = (data[20] << 24) | (data[21] << 16) | (data[22] << 8) | data[23];
+    return (width > 0) && (height > 0);
+  }
+
+  // gif: The logical screen size follows the signature.
+  if ((length >= 10) &&
+      ((memcmp(data, "GIF87a", 6) == 0) || (memcmp(data, "GIF89a", 6) == 0)))
+  {
+    width = data[6] | (data[7] << 8);
+    height = data[8] | (data[9] << 8);
+    return (width > 0) && (height > 0);
+  }
+
+  // jpeg: We need to search for the "start of frame" segment.
+  if ((length >= 4) && (data[0] == 0xFF) && (data[1] == 0xD8))
+  {
+    size_t pos = 2;
+    while (pos + 4 <= length)
+    {
+      if (data[pos] != 0xFF)
+        return false;
+      unsigned char marker = data[pos + 1];
+      // Fill bytes
+      if (marker == 0xFF)
+      {
+        pos++;
+        continue;
+      }
+      // Markers without a length field
+      if ((marker == 0x01) || ((marker >= 0xD0) && (marker <= 0xD8)))
+      {
+        pos += 2;
+        continue;
+      }
+      // The image data starts before we found the size
+      if ((marker == 0xD9) || (marker == 0xDA))
+        return false;
+      size_t segmentLength = (data[pos + 2] << 8) | data[pos + 3];
+      if ((marker >= 0xC0) && (marker <= 0xCF) &&
+          (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC))
+      {
+        if (pos + 9 > length)
+          return false;
+        height = (data[pos + 5] << 8) | data[pos + 6];
+        width = (data[pos + 7] << 8) | data[pos + 8];
+        return (width > 0) && (height > 0);
+      }
+      pos += 2 + segmentLength;
+    }
+  }
+  return false;
+}
+
 wxBitmap Image::GetUnscaledBitmap() const
 {
   if (m_svgRast)
@@ -88,6 +154,7 @@ Image::Image(Configuration **config)
   m_maxHeight = -1;
   m_svgImage = NULL;
   m_svgRast = NULL;
+  m_wxmxSaveId = 0;
 }
 
 Image::Image(Configuration **config, wxMemoryBuffer image, wxString type)
@@ -102,6 +169,7 @@ Image::Image(Configuration **config, wxMemoryBuffer image, wxString type)
   m_originalHeight = 480;
   m_svgImage = NULL;
   m_svgRast = NULL;
+  m_wxmxSaveId = 0;
   
   wxImage Image;
   if (m_compressedImage.GetDataLen() > 0)
@@ -120,6 +188,7 @@ Image::Image(Configuration **config, const wxBitmap &bitmap)
 {
   m_svgImage = NULL;
   m_svgRast = NULL;
+  m_wxmxSaveId = 0;
   m_configuration = config;
   m_width = 1;
   m_height = 1;
@@ -133,6 +202,7 @@ Image::Image(Configuration **config, wxString image, bool remove, wxFileSystem *
 {
   m_svgImage = NULL;
   m_svgRast = NULL;
+  m_wxmxSaveId = 0;
   m_configuration = config;
   m_scaledBitmap.Create(1, 1);
   m_width = 1;
@@ -161,6 +231,8 @@ Image::~Image()
 
 void Image::GnuplotSource(wxString gnuplotFilename, wxString dataFilename, wxFileSystem *filesystem)
 {
+  // The next .wxmx file needs to contain the new gnuplot files.
+  m_wxmxSaveId = 0;
   m_gnuplotSource = gnuplotFilename;
   m_gnuplotData = dataFilename;
 
@@ -668,6 +740,7 @@ void Image::LoadImage(wxString image, bool remove, wxFileSystem *filesystem)
   m_extension = m_extension.Lower();
 
   wxImage Image;
+  int width, height;
   if (m_compressedImage.GetDataLen() > 0)
   {
     if((m_extension == "svg") || (m_extension == "svgz"))
@@ -735,6 +808,14 @@ void Image::LoadImage(wxString image, bool remove, wxFileSystem *filesystem)
         m_originalHeight = m_svgImage->height;
       }
     }
+    else if (ReadImageSize(m_compressedImage, width, height))
+    {
+      // The image is decoded only as soon as it is drawn for the first time.
+      // That makes opening a file containing many images much faster.
+      m_originalWidth = width;
+      m_originalHeight = height;
+      m_isOk = true;
+    }
     else
     {   
       wxMemoryInputStream istream(m_compressedImage.GetData(), m_compressedImage.GetDataLen());
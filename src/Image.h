@@ -86,6 +86,11 @@ public:
    */
   Image(Configuration **config, wxString image, bool remove = true, wxFileSystem *filesystem = NULL);
 
+  //! Images own their SVG data and temporary files => they cannot be copied
+  Image(const Image&) = delete;
+  //! This class doesn't have a = operator
+  Image& operator=(const Image&) = delete;
+
   ~Image();
 
   /*! Sets the name of the gnuplot source and data file of this image
@@ -130,6 +135,15 @@ public:
   
   //! Reads the compressed image into a memory buffer
   static wxMemoryBuffer ReadCompressedImage(wxInputStream *data);
+
+  /*! Reads the size of a png, gif or jpeg image from its header
+
+    Decoding the whole image just in order to know its size is slow and isn't
+    needed before the image is actually drawn.
+    \return false, if the image isn't in one of these formats or its header
+    is broken.
+   */
+  static bool ReadImageSize(const wxMemoryBuffer &image, int &width, int &height);
   
   //! Returns the file name extension of the current image
   wxString GetExtension() const
@@ -185,6 +199,14 @@ public:
   //! The image in its original compressed form
   wxMemoryBuffer m_compressedImage;
 
+  /*! The number of the .wxmx save this image has last been written in
+
+    See Cell::CellPointers::WXMXReuseEntry(). 0 means: Needs to be written anew.
+   */
+  long m_wxmxSaveId;
+  //! The name of the .wxmx entry this image has last been written to
+  wxString m_wxmxName;
+
   //! Can this image be exported in SVG format?
   bool CanExportSVG() const {return m_svgRast != NULL;}
 protected:
@@ -46,6 +46,8 @@ ImgCell::ImgCell(Cell *parent, Configuration **config, CellPointers *cellpointer
   m_drawRectangle = true;
   m_imageBorderWidth = 1;
   m_drawBoundingBox = false;
+  m_maxWidth = -1;
+  m_maxHeight = -1;
 }
 
 ImgCell::ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointers, wxMemoryBuffer image, wxString type) :
@@ -56,6 +58,8 @@ ImgCell::ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointer
   m_drawRectangle = true;
   m_imageBorderWidth = 1;
   m_drawBoundingBox = false;
+  m_maxWidth = -1;
+  m_maxHeight = -1;
 }
 
 ImgCell::ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointers, const wxBitmap &bitmap) :
@@ -67,6 +71,8 @@ ImgCell::ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointer
   m_drawRectangle = true;
   m_imageBorderWidth = 1;
   m_drawBoundingBox = false;
+  m_maxWidth = -1;
+  m_maxHeight = -1;
 }
 
 int ImgCell::s_counter = 0;
@@ -82,6 +88,20 @@ ImgCell::ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointer
   else
     m_image = std::shared_ptr<Image>(new Image(m_configuration));
   m_drawBoundingBox = false;
+  m_maxWidth = -1;
+  m_maxHeight = -1;
+}
+
+ImgCell::ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointers, std::shared_ptr<Image> image)
+  : Cell(parent, config, cellPointers),
+    m_image(image)
+{
+  m_type = MC_TYPE_IMAGE;
+  m_drawRectangle = true;
+  m_imageBorderWidth = 1;
+  m_drawBoundingBox = false;
+  m_maxWidth = -1;
+  m_maxHeight = -1;
 }
 
 void ImgCell::LoadImage(wxString image, bool remove)
@@ -101,7 +121,24 @@ ImgCell::ImgCell(const ImgCell &cell):
   CopyCommonData(cell);
   m_drawRectangle = cell.m_drawRectangle;
   m_drawBoundingBox = false;
-  m_image = std::shared_ptr<Image>(new Image(*cell.m_image));
+  m_maxWidth = cell.m_maxWidth;
+  m_maxHeight = cell.m_maxHeight;
+  // Images never change once they are loaded => copies can share them
+  // instead of duplicating the image data.
+  m_image = cell.m_image;
+}
+
+void ImgCell::RecalculateImage()
+{
+  Configuration *configuration = (*m_configuration);
+  // The image may be shared with other cells that use different size limits
+  // => apply ours every time the image is scaled for this cell.
+  m_image->SetMaxWidth(m_maxWidth);
+  m_image->SetListHeight(m_maxHeight);
+  if (configuration->GetPrinting())
+    m_image->Recalculate(configuration->GetZoomFactor() * PRINT_SIZE_MULTIPLIER);
+  else
+    m_image->Recalculate();
 }
 
 ImgCell::~ImgCell()
@@ -141,17 +178,13 @@ wxString ImgCell::GetToolTip(const wxPoint &point)
 
 void ImgCell::RecalculateWidths(int fontsize)
 {
-  Configuration *configuration = (*m_configuration);
   if (m_image)
   {
     // Here we recalculate the height, as well:
     //  - This doesn't cost much time and
     //  - as image cell's sizes might change when the resolution does
     //    we might have intermittent calculation issues otherwise
-    if (configuration->GetPrinting())
-      m_image->Recalculate(configuration->GetZoomFactor() * PRINT_SIZE_MULTIPLIER);
-    else
-      m_image->Recalculate();
+    RecalculateImage();
     m_width = m_image->m_width + 2 * m_imageBorderWidth;
   }
   Cell::RecalculateWidths(fontsize);
@@ -160,13 +193,9 @@ void ImgCell::RecalculateWidths(int fontsize)
 void ImgCell::RecalculateHeight(int fontsize)
 {
   Cell::RecalculateHeight(fontsize);
-  Configuration *configuration = (*m_configuration);
   if (m_image)
   {
-    if (configuration->GetPrinting())
-      m_image->Recalculate(configuration->GetZoomFactor() * PRINT_SIZE_MULTIPLIER);
-    else
-      m_image->Recalculate();
+    RecalculateImage();
     m_height = m_image->m_height + 2 * m_imageBorderWidth;
     m_center = m_height / 2;
   }
@@ -178,11 +207,7 @@ void ImgCell::Draw(wxPoint point)
   if (DrawThisCell(point) && (m_image != NULL))
   {
     Configuration *configuration = (*m_configuration);
-    if (configuration->GetPrinting()) {
-      m_image->Recalculate(configuration->GetZoomFactor() * PRINT_SIZE_MULTIPLIER);
-    } else {
-      m_image->Recalculate();
-    }
+    RecalculateImage();
 
     if (!InUpdateRegion()) return;
     
@@ -289,12 +314,21 @@ wxString ImgCell::ToRTF()
 wxString ImgCell::ToXML()
 {
   wxString basename = m_cellPointers->WXMXGetNewFileName();
-
-  // add the file to memory
+  wxString imageName;
   if (m_image)
+    imageName = basename + m_image->GetExtension();
+
+  // If the image hasn't changed since the last save the worksheet can copy it
+  // from the old file. Else we add the file to memory - if an identical
+  // image hasn't been written already.
+  bool reuse = false;
+  if ((m_image) &&
+      (!m_cellPointers->WXMXKnownImage(m_image->GetCompressedImage(), imageName)))
   {
-    if (m_image->GetCompressedImage())
-      wxMemoryFSHandler::AddFile(basename + m_image->GetExtension(),
+    reuse = m_cellPointers->WXMXReuseEntry(m_image->m_wxmxSaveId, m_image->m_wxmxName,
+                                           imageName);
+    if ((!reuse) && (m_image->GetCompressedImage()))
+      wxMemoryFSHandler::AddFile(imageName,
                                  m_image->GetCompressedImage().GetData(),
                                  m_image->GetCompressedImage().GetDataLen()
       );
@@ -307,11 +341,11 @@ wxString ImgCell::ToXML()
   if(!m_drawRectangle)
     flags += wxT(" rect=\"false\"");
 
-  if(m_image->GetMaxWidth() > 0)
-    flags += wxString::Format(wxT(" maxWidth=\"%f\""), m_image->GetMaxWidth());
+  if(m_maxWidth > 0)
+    flags += wxString::Format(wxT(" maxWidth=\"%f\""), m_maxWidth);
 
-  if(m_image->GetHeightList() > 0)
-    flags += wxString::Format(wxT(" maxHeight=\"%f\""), m_image->GetHeightList());
+  if(m_maxHeight > 0)
+    flags += wxString::Format(wxT(" maxHeight=\"%f\""), m_maxHeight);
 
   if (m_image)
   {
@@ -333,31 +367,47 @@ wxString ImgCell::ToXML()
     if(gnuplotSource != wxEmptyString)
     {
       flags += " gnuplotsource=\"" + gnuplotSource + "\"";
-      wxMemoryBuffer data = m_image->GetGnuplotSource();
-      if(data.GetDataLen() > 0)
+      // A cell sharing this image might already have written this file
+      if(!m_cellPointers->WXMXKnownEntry(gnuplotSource))
       {
-        wxMemoryFSHandler::AddFile(gnuplotSource,
-                                   data.GetData(),
-                                   data.GetDataLen()
-          );
+        wxMemoryBuffer data;
+        if(reuse)
+          m_cellPointers->WXMXReuseOptionalEntry(gnuplotSource);
+        else
+          data = m_image->GetGnuplotSource();
+        if(data.GetDataLen() > 0)
+        {
+          wxMemoryFSHandler::AddFile(gnuplotSource,
+                                     data.GetData(),
+                                     data.GetDataLen()
+            );
+        }
       }
     }
     if(gnuplotData != wxEmptyString)
     {
       flags += " gnuplotdata=\"" + gnuplotData + "\"";
-      wxMemoryBuffer data = m_image->GetGnuplotData();
-      if(data.GetDataLen() > 0)
+      // A cell sharing this image might already have written this file
+      if(!m_cellPointers->WXMXKnownEntry(gnuplotData))
       {
-        wxMemoryFSHandler::AddFile(gnuplotData,
-                                   data.GetData(),
-                                   data.GetDataLen()
-          );
+        wxMemoryBuffer data;
+        if(reuse)
+          m_cellPointers->WXMXReuseOptionalEntry(gnuplotData);
+        else
+          data = m_image->GetGnuplotData();
+        if(data.GetDataLen() > 0)
+        {
+          wxMemoryFSHandler::AddFile(gnuplotData,
+                                     data.GetData(),
+                                     data.GetDataLen()
+            );
+        }
       }
     }
   }
   
   return (wxT("<img") + flags + wxT(">") +
-          basename + m_image->GetExtension() + wxT("</img>"));
+          imageName + wxT("</img>"));
 }
 
 bool ImgCell::CopyToClipboard()
@@ -37,6 +37,8 @@ public:
   ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointers, wxMemoryBuffer image, wxString type);
   ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointers, wxString image, bool remove = true,
           wxFileSystem *filesystem = NULL);
+  //! A constructor that shows an image another cell shows, too
+  ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointers, std::shared_ptr<Image> image);
 
   ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointers, const wxBitmap &bitmap);
   ImgCell(const ImgCell &cell);
@@ -116,10 +118,14 @@ public:
   wxMemoryBuffer GetCompressedImage() const
   { return m_image->m_compressedImage; }
 
-  double GetMaxWidth() const {if(m_image != NULL) return m_image->GetMaxWidth(); else return -1;}
-  double GetHeightList() const {if(m_image != NULL) return m_image->GetHeightList();else return -1;}
-  void SetMaxWidth(double width) const {if(m_image != NULL) return m_image->SetMaxWidth(width);}
-  void SetListHeight(double height) const {if(m_image != NULL) return m_image->SetListHeight(height);}
+  //! The image this cell shows. Copies of this cell share it.
+  std::shared_ptr<Image> GetImage() const
+  { return m_image; }
+
+  double GetMaxWidth() const {return m_maxWidth;}
+  double GetHeightList() const {return m_maxHeight;}
+  void SetMaxWidth(double width){m_maxWidth = width;}
+  void SetListHeight(double height){m_maxHeight = height;}
 
   void RecalculateHeight(int fontsize) override;
 
@@ -149,7 +155,13 @@ protected:
   }
 
 private:
+  //! Scales the (possibly shared) image using this cell's size limits
+  void RecalculateImage();
   bool m_drawBoundingBox;
+  //! The upper width limit for displaying this cell's image
+  double m_maxWidth;
+  //! The upper height limit for displaying this cell's image
+  double m_maxHeight;
 };
 
 #endif // IMGCELL_H
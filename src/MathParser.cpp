@@ -29,6 +29,7 @@
 #include <wx/sstream.h>
 #include <wx/regex.h>
 #include <wx/intl.h>
+#include <vector>
 
 #include "MathParser.h"
 
@@ -952,9 +953,28 @@ Cell *MathParser::ParseTag(wxXmlNode *node, bool all)
       {
         ImgCell *imageCell;
         wxString filename(node->GetChildren()->GetContent());
+        wxString gnuplotSource = node->GetAttribute(wxT("gnuplotsource"), wxEmptyString);
+        wxString gnuplotData = node->GetAttribute(wxT("gnuplotdata"), wxEmptyString);
+        bool sharedImage = false;
 
         if (m_fileSystem) // loading from zip
-          imageCell = new ImgCell(NULL, m_configuration, m_cellPointers, filename, false, m_fileSystem.get());
+        {
+          // Identical images are stored in the .wxmx file only once => we
+          // load them only once, as well. The gnuplot files belong to the
+          // shared image, too => only cells that name the same ones share it.
+          wxString imageKey = filename + wxT("\n") + gnuplotSource + wxT("\n") + gnuplotData;
+          std::map<wxString, std::shared_ptr<Image>>::const_iterator loaded = m_loadedImages.find(imageKey);
+          if (loaded != m_loadedImages.end())
+          {
+            imageCell = new ImgCell(NULL, m_configuration, m_cellPointers, loaded->second);
+            sharedImage = true;
+          }
+          else
+          {
+            imageCell = new ImgCell(NULL, m_configuration, m_cellPointers, filename, false, m_fileSystem.get());
+            m_loadedImages[imageKey] = imageCell->GetImage();
+          }
+        }
         else
         {
           if (node->GetAttribute(wxT("del"), wxT("yes")) != wxT("no"))
@@ -973,9 +993,7 @@ Cell *MathParser::ParseTag(wxXmlNode *node, bool all)
             imageCell = new ImgCell(NULL, m_configuration, m_cellPointers, filename, false, NULL);
           }
         }
-        wxString gnuplotSource = node->GetAttribute(wxT("gnuplotsource"), wxEmptyString);
-        wxString gnuplotData = node->GetAttribute(wxT("gnuplotdata"), wxEmptyString);
-        if((imageCell != NULL) && (gnuplotSource != wxEmptyString))
+        if((imageCell != NULL) && (gnuplotSource != wxEmptyString) && (!sharedImage))
           imageCell->GnuplotSource(gnuplotSource, gnuplotData, m_fileSystem.get());
 
         if (node->GetAttribute(wxT("rect"), wxT("true")) == wxT("false"))
@@ -1100,6 +1118,257 @@ Cell *MathParser::ParseTag(wxXmlNode *node, bool all)
   return retval;
 }
 
+wxString MathParser::DecodeEntities(const wxString &s)
+{
+  if (s.Find(wxT('&')) == wxNOT_FOUND)
+    return s;
+
+  wxString result;
+  wxString::const_iterator it = s.begin();
+  while (it != s.end())
+  {
+    if (*it != wxT('&'))
+    {
+      result += *it;
+      ++it;
+      continue;
+    }
+    wxString entity;
+    wxString::const_iterator end = it;
+    ++end;
+    while ((end != s.end()) && (*end != wxT(';')) && (entity.Length() < 10))
+    {
+      entity += *end;
+      ++end;
+    }
+    if ((end == s.end()) || (*end != wxT(';')))
+    {
+      // Not an entity after all
+      result += *it;
+      ++it;
+      continue;
+    }
+    long code;
+    if (entity == wxT("amp"))
+      result += wxT('&');
+    else if (entity == wxT("lt"))
+      result += wxT('<');
+    else if (entity == wxT("gt"))
+      result += wxT('>');
+    else if (entity == wxT("quot"))
+      result += wxT('"');
+    else if (entity == wxT("apos"))
+      result += wxT('\'');
+    else if (entity.StartsWith(wxT("#x")) && entity.Mid(2).ToLong(&code, 16))
+      result += wxUniChar(code);
+    else if (entity.StartsWith(wxT("#")) && entity.Mid(1).ToLong(&code))
+      result += wxUniChar(code);
+    else
+      result += wxT("&") + entity + wxT(";");
+    it = end;
+    ++it;
+  }
+  return result;
+}
+
+wxXmlNode *MathParser::DecodeCompactXml(const wxString &s)
+{
+  // The tags the compact format refers to by number.
+  // Must match *wx-compact-tags* in wxMathML.lisp.
+  static const wxString compactTags[] = {
+    wxT("mth"), wxT("lbl"), wxT("mrow"), wxT("p"), wxT("mi"), wxT("mn"),
+    wxT("mo"), wxT("h"), wxT("t"), wxT("st"), wxT("fn"), wxT("fnm"),
+    wxT("munder"), wxT("msup"), wxT("mspace"), wxT("f"), wxT("q"), wxT("s"),
+    wxT("g"), wxT("tb"), wxT("mtr"), wxT("mtd"), wxT("ie"), wxT("in"),
+    wxT("sm"), wxT("lm"), wxT("at"), wxT("d"), wxT("a"), wxT("cj"),
+    wxT("hl"), wxT("mmultiscripts"), wxT("mfrac")
+  };
+  const long numCompactTags = sizeof(compactTags) / sizeof(compactTags[0]);
+
+  enum
+  {
+    text,          //!< Within the contents of an element
+    tagName,       //!< After a "{"
+    attributeName, //!< After a "@"
+    attributeValue //!< After the "=" of an attribute
+  } state = text;
+
+  wxXmlNode *root = new wxXmlNode(wxXML_ELEMENT_NODE, wxT("span"));
+  // The node we currently add children to, the nodes that contain it and
+  // its last child: wxXmlNode::AddChild() would have to search for the
+  // latter every time we add a child.
+  wxXmlNode *parent = root;
+  std::vector<wxXmlNode *> parents;
+  wxXmlNode *lastChild = NULL;
+  // The element whose attributes we are reading
+  wxXmlNode *element = NULL;
+  wxString token;
+  wxString attributeName;
+
+  wxString contents = s;
+  if (contents.StartsWith(wxT("<cmth>")))
+    contents = contents.Mid(6);
+  if (contents.EndsWith(wxT("</cmth>")))
+    contents.Truncate(contents.Length() - 7);
+
+  for (wxString::const_iterator it = contents.begin(); it != contents.end(); ++it)
+  {
+    wxChar c = *it;
+    bool escaped = false;
+    if (c == wxT('\\'))
+    {
+      ++it;
+      if (it == contents.end())
+        break;
+      c = *it;
+      escaped = true;
+    }
+
+    switch (state)
+    {
+    case text:
+      if ((!escaped) && ((c == wxT('{')) || (c == wxT('}'))))
+      {
+        if (!token.IsEmpty())
+        {
+          wxXmlNode *node = new wxXmlNode(wxXML_TEXT_NODE, wxEmptyString, DecodeEntities(token));
+          if (lastChild)
+            parent->InsertChildAfter(node, lastChild);
+          else
+            parent->AddChild(node);
+          lastChild = node;
+          token.Clear();
+        }
+        if (c == wxT('{'))
+          state = tagName;
+        else if (!parents.empty())
+        {
+          lastChild = parent;
+          parent = parents.back();
+          parents.pop_back();
+        }
+      }
+      else
+        token += c;
+      break;
+    case tagName:
+      if ((!escaped) && ((c == wxT('@')) || (c == wxT('|'))))
+      {
+        long id;
+        if (token.ToLong(&id) && (id >= 0) && (id < numCompactTags))
+          token = compactTags[id];
+        element = new wxXmlNode(wxXML_ELEMENT_NODE, token);
+        token.Clear();
+        if (c == wxT('@'))
+          state = attributeName;
+        else
+        {
+          if (lastChild)
+            parent->InsertChildAfter(element, lastChild);
+          else
+            parent->AddChild(element);
+          parents.push_back(parent);
+          parent = element;
+          lastChild = NULL;
+          state = text;
+        }
+      }
+      else
+        token += c;
+      break;
+    case attributeName:
+      if (c == wxT('='))
+      {
+        attributeName = token;
+        token.Clear();
+        state = attributeValue;
+      }
+      else
+        token += c;
+      break;
+    case attributeValue:
+      if ((!escaped) && ((c == wxT('@')) || (c == wxT('|'))))
+      {
+        element->AddAttribute(attributeName, DecodeEntities(token));
+        token.Clear();
+        if (c == wxT('@'))
+          state = attributeName;
+        else
+        {
+          if (lastChild)
+            parent->InsertChildAfter(element, lastChild);
+          else
+            parent->AddChild(element);
+          parents.push_back(parent);
+          parent = element;
+          lastChild = NULL;
+          state = text;
+        }
+      }
+      else
+        token += c;
+      break;
+    }
+  }
+
+  // An element whose attributes are incomplete hasn't been added to the tree yet.
+  if ((state == attributeName) || (state == attributeValue))
+    delete element;
+  return root;
+}
+
+void MathParser::NodeToXml(wxXmlNode *node, wxString &xml)
+{
+  for (; node != NULL; node = node->GetNext())
+  {
+    if (node->GetType() == wxXML_TEXT_NODE)
+    {
+      wxString text = node->GetContent();
+      text.Replace(wxT("&"), wxT("&amp;"));
+      text.Replace(wxT("<"), wxT("&lt;"));
+      text.Replace(wxT(">"), wxT("&gt;"));
+      xml += text;
+      continue;
+    }
+    xml += wxT("<") + node->GetName();
+    for (wxXmlAttribute *attr = node->GetAttributes(); attr != NULL; attr = attr->GetNext())
+    {
+      wxString value = attr->GetValue();
+      value.Replace(wxT("&"), wxT("&amp;"));
+      value.Replace(wxT("<"), wxT("&lt;"));
+      value.Replace(wxT("\""), wxT("&quot;"));
+      xml += wxT(" ") + attr->GetName() + wxT("=\"") + value + wxT("\"");
+    }
+    if (node->GetChildren() == NULL)
+      xml += wxT("/>");
+    else
+    {
+      xml += wxT(">");
+      NodeToXml(node->GetChildren(), xml);
+      xml += wxT("</") + node->GetName() + wxT(">");
+    }
+  }
+}
+
+wxString MathParser::CompactToXml(const wxString &s)
+{
+  wxString result;
+  wxString rest = s;
+  int start;
+  while ((start = rest.Find(wxT("<cmth>"))) != wxNOT_FOUND)
+  {
+    int end = rest.Find(wxT("</cmth>"));
+    if (end < start)
+      break;
+    result += rest.Left(start);
+    wxXmlNode *root = DecodeCompactXml(rest.SubString(start, end + 6));
+    NodeToXml(root->GetChildren(), result);
+    delete root;
+    rest = rest.Mid(end + 7);
+  }
+  return result + rest;
+}
+
 /***
  * Parse the string s, which is (correct) xml fragment.
  * Put the result in line.
@@ -1133,14 +1402,40 @@ Cell *MathParser::ParseLine(wxString s, CellType style)
 
   m_graphRegex.Replace(&s, wxT("\uFFFD"));
 
-  if (((long) s.Length() < showLength) || (showLength == 0))
+  // The limit is meant for the XML form of the output. The compact format
+  // needs only about half as many characters for the same expression.
+  bool compact = s.StartsWith(wxT("<cmth>"));
+  long length = s.Length();
+  if (compact)
+    length *= 2;
+
+  if ((length < showLength) || (showLength == 0))
   {
 
     wxXmlDocument xml;
 
-    wxStringInputStream xmlStream(s);
+    if (compact)
+    {
+      // The decoded <mth> element is wrapped in a container node. It has to
+      // be the root, though, as it is if the XML is parsed: Else ParseTag()
+      // would lay out the <mth> element itself instead of its contents.
+      wxXmlNode *root = DecodeCompactXml(s);
+      wxXmlNode *mth = root->GetChildren();
+      if ((mth != NULL) && (mth->GetNext() == NULL) &&
+          (mth->GetType() == wxXML_ELEMENT_NODE))
+      {
+        root->RemoveChild(mth);
+        delete root;
+        root = mth;
+      }
+      xml.SetRoot(root);
+    }
+    else
+    {
+      wxStringInputStream xmlStream(s);
 
-    xml.Load(xmlStream, wxT("UTF-8"), wxXMLDOC_KEEP_WHITESPACE_NODES);
+      xml.Load(xmlStream, wxT("UTF-8"), wxXMLDOC_KEEP_WHITESPACE_NODES);
+    }
 
     wxXmlNode *doc = xml.GetRoot();
 
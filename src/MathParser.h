@@ -37,6 +37,7 @@ The header file for the xml cell parser
 #include "TextCell.h"
 #include "EditorCell.h"
 #include "FracCell.h"
+#include "Image.h"
 
 /*! This class handles parsing the xml representation of a cell tree.
 
@@ -58,6 +59,12 @@ public:
 
   Cell *ParseTag(wxXmlNode *node, bool all = true);
 
+  /*! Replaces all math in the compact format in s by XML
+
+    Needed for the rare places that expect maxima's output to be XML.
+   */
+  static wxString CompactToXml(const wxString &s);
+
 private:
   static void ParseCommonAttrs(wxXmlNode *node, Cell *cell);
 
@@ -133,6 +140,21 @@ private:
   Cell *ParseSubSupTag(wxXmlNode *node);
 
   Cell *ParseMmultiscriptsTag(wxXmlNode *node);
+
+  /*! Converts maxima's output in the compact format to a tree of XML nodes
+
+    In this format, which wx-write-compact in wxMathML.lisp generates, an
+    element is written as {tag\@attribute=value|contents} with tag being the
+    number of a common tag or the tag's name. The node that is returned
+    contains the decoded elements as its children.
+   */
+  static wxXmlNode *DecodeCompactXml(const wxString &s);
+
+  //! Resolves the XML entities the compact format leaves in texts
+  static wxString DecodeEntities(const wxString &s);
+
+  //! Appends the XML representation of node and its children to xml
+  static void NodeToXml(wxXmlNode *node, wxString &xml);
   
   wxString m_userDefinedLabel;
   wxRegEx m_graphRegex;
@@ -143,6 +165,8 @@ private:
   Configuration **m_configuration;
   bool m_highlight;
   std::unique_ptr<wxFileSystem> m_fileSystem; // used for loading pictures in <img> and <slide>
+  //! The images we have loaded from the .wxmx file, by their file name and gnuplot files
+  std::map<wxString, std::shared_ptr<Image>> m_loadedImages;
 };
 
 #endif // MATHPARSER_H
@@ -0,0 +1,112 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2020 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*!\file
+
+  This file contains the class ParallelImageWriter that saves images in background threads
+ */
+
+#include "ParallelImageWriter.h"
+#include "BitmapOut.h"
+
+ParallelImageWriter::ParallelImageWriter()
+{
+  m_maxThreads = std::thread::hardware_concurrency();
+  if (m_maxThreads < 1)
+    m_maxThreads = 1;
+  m_finishing = false;
+  m_ok = true;
+}
+
+ParallelImageWriter::~ParallelImageWriter()
+{
+  Finish();
+}
+
+void ParallelImageWriter::Add(wxImage &image, const wxString &file)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    // Don't let the images that wait for being written fill up the memory.
+    while (m_jobs.size() >= 2 * m_maxThreads)
+      m_jobTaken.wait(lock);
+
+    m_jobs.push_back(Job());
+    m_jobs.back().m_image = image;
+    m_jobs.back().m_file = file;
+    // Make sure that the thread that writes the image owns the only
+    // reference to it.
+    image = wxNullImage;
+    m_finishing = false;
+  }
+  m_jobAdded.notify_one();
+
+  // Start the threads only as soon as we know that we need them.
+  if (m_threads.size() < m_maxThreads)
+    m_threads.push_back(std::thread(&ParallelImageWriter::WriterThread, this));
+}
+
+bool ParallelImageWriter::Finish()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_finishing = true;
+  }
+  m_jobAdded.notify_all();
+  for (std::vector<std::thread>::iterator it = m_threads.begin(); it != m_threads.end(); ++it)
+    it->join();
+  m_threads.clear();
+  return m_ok;
+}
+
+void ParallelImageWriter::Cancel()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_jobs.clear();
+  }
+  m_jobTaken.notify_all();
+  Finish();
+}
+
+void ParallelImageWriter::WriterThread()
+{
+  while (true)
+  {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      while (m_jobs.empty() && !m_finishing)
+        m_jobAdded.wait(lock);
+      if (m_jobs.empty())
+        return;
+      job = m_jobs.front();
+      m_jobs.pop_front();
+    }
+    m_jobTaken.notify_one();
+
+    if (!BitmapOut::SaveImage(job.m_image, job.m_file))
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_ok = false;
+    }
+  }
+}
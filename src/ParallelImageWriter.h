@@ -0,0 +1,105 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2020 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*!\file
+
+  This file defines the class ParallelImageWriter that saves images in background threads
+ */
+
+#ifndef PARALLELIMAGEWRITER_H
+#define PARALLELIMAGEWRITER_H
+
+#include <wx/image.h>
+#include <wx/string.h>
+#include <list>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*! Saves images to files using a pool of background threads
+
+  Rendering cells to a bitmap needs the GUI thread. But encoding the
+  resulting image as png and writing it to disk doesn't => The exports
+  render an image, hand it over to this class and continue with the next
+  cell while the image is written in the background.
+ */
+class ParallelImageWriter
+{
+public:
+  ParallelImageWriter();
+  //! Waits until all images are written
+  ~ParallelImageWriter();
+
+  //! This class doesn't have a copy constructor
+  ParallelImageWriter(const ParallelImageWriter&) = delete;
+  //! This class doesn't have a = operator
+  ParallelImageWriter& operator=(const ParallelImageWriter&) = delete;
+
+  /*! Queues an image for being saved
+
+    wxImage's reference counting isn't thread-safe => This class takes over
+    the image and sets the caller's copy to wxNullImage. The caller must not
+    keep any other copy of it.
+
+    If many images are waiting for being saved this function waits until
+    a thread has time for the new image so the images don't fill up the
+    memory.
+   */
+  void Add(wxImage &image, const wxString &file);
+
+  /*! Waits until all images are written
+
+    \return false, if at least one image couldn't be written.
+   */
+  bool Finish();
+
+  //! Discards all images that haven't been written yet and waits for the rest
+  void Cancel();
+
+private:
+  //! An image that waits for being saved
+  struct Job
+  {
+    wxImage m_image;
+    wxString m_file;
+  };
+
+  //! The main loop of the threads that write the images
+  void WriterThread();
+
+  std::list<Job> m_jobs;
+  std::vector<std::thread> m_threads;
+  //! The number of threads we start as soon as we get images
+  size_t m_maxThreads;
+  //! Protects m_jobs, m_finishing and m_ok
+  std::mutex m_lock;
+  //! Tells the threads that there is a new image or that they have to stop
+  std::condition_variable m_jobAdded;
+  //! Tells Add() that a thread has taken an image from the list
+  std::condition_variable m_jobTaken;
+  //! true = the threads end as soon as there are no more images
+  bool m_finishing;
+  //! false = at least one image couldn't be written
+  bool m_ok;
+};
+
+#endif // PARALLELIMAGEWRITER_H
@@ -151,8 +151,8 @@ SlideShow::SlideShow(const SlideShow &cell):
   CopyCommonData(cell);
   AnimationRunning(false);
 
-  for (size_t i = 0; i < cell.m_images.size(); i++)
-    m_images.push_back(std::shared_ptr<Image>(new Image(*cell.m_images[i])));
+  // Images never change once they are loaded => copies can share them.
+  m_images = cell.m_images;
 
   m_framerate = cell.m_framerate;
   m_displayed = true;
@@ -307,18 +307,22 @@ wxString SlideShow::ToXML()
 
   for (int i = 0; i < m_size; i++)
   {
-    wxString basename = m_cellPointers->WXMXGetNewFileName();
-    // add the file to memory
-    if (m_images[i])
+    wxString imageName = m_cellPointers->WXMXGetNewFileName() + m_images[i]->GetExtension();
+    // add the file to memory, if we cannot copy it from the last .wxmx file
+    // and haven't written an identical frame already
+    if ((m_images[i]) &&
+        (!m_cellPointers->WXMXKnownImage(m_images[i]->GetCompressedImage(), imageName)))
     {
-      if (m_images[i]->GetCompressedImage())
-        wxMemoryFSHandler::AddFile(basename + m_images[i]->GetExtension(),
+      if ((!m_cellPointers->WXMXReuseEntry(m_images[i]->m_wxmxSaveId, m_images[i]->m_wxmxName,
+                                           imageName)) &&
+          (m_images[i]->GetCompressedImage()))
+        wxMemoryFSHandler::AddFile(imageName,
                                    m_images[i]->GetCompressedImage().GetData(),
                                    m_images[i]->GetCompressedImage().GetDataLen()
         );
     }
 
-    images += basename + m_images[i]->GetExtension() + wxT(";");
+    images += imageName + wxT(";");
   }
 
   wxString flags;
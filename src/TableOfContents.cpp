@@ -296,6 +296,9 @@ void TableOfContents::OnMouseRightDown(wxListEvent &event)
       popupMenu->Append(popid_Fold, _("Hide"), wxEmptyString, wxITEM_NORMAL);
       popupMenu->Append(popid_SelectTocChapter, _("Select"), wxEmptyString, wxITEM_NORMAL);
       popupMenu->Append(popid_EvalTocChapter, _("Evaluate"), wxEmptyString, wxITEM_NORMAL);
+      popupMenu->Append(popid_EvalTocChapterSeparately, _("Evaluate in a separate Maxima"),
+                        _("Evaluate this part of the document in a new window with its own Maxima process"),
+                        wxITEM_NORMAL);
     }
   }
 
@@ -53,6 +53,7 @@ public:
     popid_Unfold,
     popid_SelectTocChapter,
     popid_EvalTocChapter,
+    popid_EvalTocChapterSeparately,
     popid_ToggleTOCshowsSectionNumbers
   };
 
@@ -126,6 +126,21 @@ void Variablespane::InsertMenu(wxCommandEvent &event)
   case varID_prop:varname="props";break;
   case varID_let_rule_packages:varname="let_rule_packages";break;
   case varID_clear:Clear();break;
+  case varID_full_value:
+    if((m_rightClickRow>=0)&&(m_rightClickRow<GetNumberRows()))
+    {
+      // Toggle between the full value and a preview, forget the value we
+      // have got and let wxMaxima query the variables anew.
+      wxString name = GetCellValue(m_rightClickRow,0);
+      if(m_fullValues.find(name) != m_fullValues.end())
+        m_fullValues.erase(name);
+      else
+        m_fullValues[name] = 1;
+      m_valueHashes.erase(name);
+      wxMenuEvent *VarReadEvent = new wxMenuEvent(wxEVT_MENU, varID_newVar);
+      GetParent()->GetParent()->GetEventHandler()->QueueEvent(VarReadEvent);
+    }
+    return;
   case varID_add_all:
   {
     wxMenuEvent *VarAddEvent = new wxMenuEvent(wxEVT_MENU, varID_add_all);
@@ -185,6 +200,17 @@ void Variablespane::OnRightClick(wxGridEvent &event)
     popupMenu->Append(varID_gradefs,
                       _("List of user-defined let rule packages"), wxEmptyString, wxITEM_NORMAL);
   popupMenu->AppendSeparator();    
+  if((m_rightClickRow>=0) && (m_rightClickRow<GetNumberRows()))
+  {
+    wxString name = GetCellValue(m_rightClickRow,0);
+    bool full = (m_fullValues.find(name) != m_fullValues.end());
+    if(full || (m_truncated.find(name) != m_truncated.end()))
+    {
+      popupMenu->Append(varID_full_value,
+                        _("Show the full value"), wxEmptyString, wxITEM_CHECK);
+      popupMenu->Check(varID_full_value, full);
+    }
+  }
   if(GetGridCursorRow()>=0)
   {
     popupMenu->Append(varID_delete_row,
@@ -219,6 +245,8 @@ void Variablespane::OnTextChange(wxGridEvent &event)
   if((event.GetRow()>GetNumberRows()) || (event.GetRow()<0))
     return;
   BeginBatch();
+  // The value we might know for the new variable name isn't displayed.
+  m_valueHashes.erase(GetCellValue(event.GetRow(),0));
   if(IsValidVariable(GetCellValue(event.GetRow(),0)))
   {
     SetCellValue(event.GetRow(),1,wxT(""));
@@ -261,11 +289,26 @@ void Variablespane::OnTextChange(wxGridEvent &event)
   EndBatch();
 }
 
-void Variablespane::VariableValue(wxString var, wxString val)
+void Variablespane::VariableValue(wxString var, wxString val, wxString hash, long size)
 {
+  wxString name = UnescapeVarname(var);
+  if(hash != wxEmptyString)
+    m_valueHashes[name] = hash;
+  else
+    m_valueHashes.erase(name);
+  if(size > (long) val.Length())
+  {
+    m_truncated[name] = 1;
+    val += wxString::Format(_("... (%li characters)"), size);
+  }
+  else
+    m_truncated.erase(name);
+
   for(int i = 0; i < GetNumberRows(); i++)
-    if(GetCellValue(i,0) == UnescapeVarname(var))
+    if(GetCellValue(i,0) == name)
     {
+      if((GetCellValue(i,1) == val) && (GetCellTextColour(i,1) == *wxBLACK))
+        continue;
       SetCellTextColour(i,1,*wxBLACK);
       SetCellValue(i,1,val);
       RefreshAttr(i, 1);
@@ -274,9 +317,14 @@ void Variablespane::VariableValue(wxString var, wxString val)
 
 void Variablespane::VariableUndefined(wxString var)
 {
+  wxString name = UnescapeVarname(var);
+  m_valueHashes.erase(name);
+  m_truncated.erase(name);
   for(int i = 0; i < GetNumberRows(); i++)
-    if(GetCellValue(i,0) == UnescapeVarname(var))
+    if(GetCellValue(i,0) == name)
     {
+      if((GetCellValue(i,1) == _("Undefined")) && (GetCellTextColour(i,1) == *wxLIGHT_GREY))
+        continue;
       SetCellTextColour(i,1,*wxLIGHT_GREY);
       SetCellValue(i,1,_("Undefined"));
       RefreshAttr(i, 1);
@@ -295,6 +343,26 @@ wxArrayString Variablespane::GetEscapedVarnames()
   return retVal;
 }
 
+wxString Variablespane::QueryArgument(wxString var)
+{
+  wxString hash;
+  bool full = false;
+  for(int i = 0; i < GetNumberRows(); i++)
+  {
+    wxString name = GetCellValue(i,0);
+    if(InvertCase(EscapeVarname(name)) == var)
+    {
+      StringHash::const_iterator it = m_valueHashes.find(name);
+      if(it != m_valueHashes.end())
+        hash = it->second;
+      full = (m_fullValues.find(name) != m_fullValues.end());
+      break;
+    }
+  }
+  return wxT("(\"") + var + wxT("\" \"") + hash + wxT("\" ") +
+    (full ? wxT("t") : wxT("nil")) + wxT(")");
+}
+
 wxArrayString Variablespane::GetVarnames()
 {
   wxArrayString retVal;
@@ -415,6 +483,8 @@ bool Variablespane::IsValidVariable(wxString var)
 
 void Variablespane::ResetValues()
 {
+  m_valueHashes.clear();
+  m_truncated.clear();
   for(int i = 0; i < GetNumberRows(); i++)
   {
     if(GetCellValue(i,0) != wxEmptyString)
@@ -430,6 +500,9 @@ void Variablespane::ResetValues()
 
 void Variablespane::Clear()
 {
+  m_valueHashes.clear();
+  m_truncated.clear();
+  m_fullValues.clear();
   while(GetNumberRows() > 1)
     DeleteRows(0);    
 }
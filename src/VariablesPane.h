@@ -54,7 +54,8 @@ public:
     varID_let_rule_packages,
     varID_add_all,
     varID_delete_row,
-    varID_clear
+    varID_clear,
+    varID_full_value
   };
 
   //! The constructor
@@ -89,8 +90,24 @@ public:
   wxString EscapeVarname(wxString var);
   //! Convert a variable name maxima understands to human-readable
   wxString UnescapeVarname(wxString var);
-  //! Tell the variables pane about a variable value
-  void VariableValue(wxString var, wxString val);
+  /*! Tell the variables pane about a variable value
+
+    Rows whose value hasn't changed aren't touched so they don't need to be
+    redrawn.
+    \param var The variable name maxima has sent
+    \param val The value or, for big values, the first part of it
+    \param hash The hash of the value maxima has calculated
+    \param size The length of the complete value. -1 = unknown.
+   */
+  void VariableValue(wxString var, wxString val, wxString hash = wxEmptyString, long size = -1);
+  /*! The argument wx-query-variables needs in order to query a variable
+
+    Tells maxima which value we already know so maxima doesn't need to send
+    it again and if the user wants to see the full value instead of only its
+    beginning.
+    \param var The variable name as returned by GetEscapedVarnames()
+  */
+  wxString QueryArgument(wxString var);
   //! Sets the variable var to "undefined"
   void VariableUndefined(wxString var);
   //! The destructor
@@ -98,8 +115,15 @@ public:
 private:
   wxString InvertCase(wxString var);
   WX_DECLARE_STRING_HASH_MAP(int, IntHash);
+  WX_DECLARE_STRING_HASH_MAP(wxString, StringHash);
   //! A list of all symbols that can be entered using Esc-Codes
   IntHash m_vars;
+  //! The hashes of the variable values we have got from maxima
+  StringHash m_valueHashes;
+  //! The variables maxima has sent only the beginning of the value for
+  IntHash m_truncated;
+  //! The variables the user wants to see the full value of
+  IntHash m_fullValues;
   //! The row that was right-clicked at
   int m_rightClickRow;
   //! Compares two integers.
@@ -47,6 +47,8 @@
 #include "ImgCell.h"
 #include "MarkDown.h"
 #include "ConfigDialogue.h"
+#include "XmlStreamWriter.h"
+#include "ParallelImageWriter.h"
 
 #include <wx/clipbrd.h>
 #include <wx/caret.h>
@@ -64,8 +66,12 @@
 #include <wx/txtstrm.h>
 #include <wx/filesys.h>
 #include <wx/fs_mem.h>
+#include <wx/thread.h>
+#include <wx/progdlg.h>
 #include <stdlib.h>
 #include "memory"
+#include <thread>
+#include <atomic>
 
 //! This class represents the worksheet shown in the middle of the wxMaxima window.
 Worksheet::Worksheet(wxWindow *parent, int id, wxPoint pos, wxSize size) :
@@ -120,7 +126,7 @@ Worksheet::Worksheet(wxWindow *parent, int id, wxPoint pos, wxSize size) :
 
   m_dc = new wxClientDC(this);
   m_configuration->SetContext(*m_dc);
-  m_autocomplete  = new AutoComplete(m_configuration);
+  m_autocomplete  = new AutoComplete(m_configuration, &m_cellPointers.m_worksheetWords);
   m_configuration->SetWorkSheet(this);
   m_configuration->ReadConfig();
   m_redrawStart = NULL;
@@ -137,6 +143,8 @@ Worksheet::Worksheet(wxWindow *parent, int id, wxPoint pos, wxSize size) :
   m_lastTop = 0;
   m_lastBottom = 0;
   m_followEvaluation = true;
+  m_wxmxLastFileTime = 0;
+  m_wxmxLastSaveId = 0;
   TreeUndo_ActiveCell = NULL;
   m_questionPrompt = false;
   m_scheduleUpdateToc = false;
@@ -380,6 +388,8 @@ Worksheet::~Worksheet()
   m_dc = NULL;
   wxDELETE(m_tree);
   m_tree =NULL;
+  // Waits for the autocompletion's background scans to finish
+  wxDELETE(m_autocomplete);
 }
 
 #if wxCHECK_VERSION(3, 1, 2)
@@ -687,6 +697,17 @@ GroupCell *Worksheet::InsertGroupCells(GroupCell *cells, GroupCell *where)
 // InsertGroupCells
 // inserts groupcells after position "where" (NULL = top of the document)
 // Multiple groupcells can be inserted when tree->m_next != NULL
+void Worksheet::RegisterWordLists(GroupCell *cells)
+{
+  for (GroupCell *cell = cells; cell != NULL; cell = cell->GetNext())
+  {
+    if (cell->GetEditable())
+      cell->GetEditable()->RegisterWordList();
+    if (cell->GetHiddenTree())
+      RegisterWordLists(cell->GetHiddenTree());
+  }
+}
+
 // Returns the pointer to the last inserted group cell to have fun with
 GroupCell *Worksheet::InsertGroupCells(
         GroupCell *cells,
@@ -706,6 +727,9 @@ GroupCell *Worksheet::InsertGroupCells(
   GroupCell *lastOfCellsToInsert = cells;
   if (lastOfCellsToInsert->IsFoldable() || (lastOfCellsToInsert->GetGroupType() == GC_TYPE_IMAGE))
     renumbersections = true;
+  // Only cells that are part of the worksheet add their words to the
+  // autocompletion's list of worksheet words.
+  RegisterWordLists(cells);
   while (lastOfCellsToInsert->m_next)
   {
     lastOfCellsToInsert = lastOfCellsToInsert->GetNext();
@@ -5332,8 +5356,28 @@ bool Worksheet::ExportToHTML(wxString file)
   // Write the actual contents
   //////////////////////////////////////////////
 
+  // The bitmaps we render are written to disk by background threads while we
+  // already render the next ones.
+  ParallelImageWriter imageWriter;
+
+  int cellCount = 0;
+  for (GroupCell *cell = tmp; cell != NULL; cell = cell->GetNext())
+    cellCount++;
+  wxProgressDialog progress(_("Exporting to HTML"), _("Exporting the worksheet..."),
+                            cellCount, this,
+                            wxPD_APP_MODAL | wxPD_AUTO_HIDE | wxPD_CAN_ABORT | wxPD_ELAPSED_TIME);
+  int cellNumber = 0;
+
   while (tmp != NULL)
   {
+    if (!progress.Update(cellNumber++))
+    {
+      imageWriter.Cancel();
+      m_configuration->ClipToDrawRegion(true);
+      RecalculateForce();
+      wxLogMessage(_("HTML export cancelled"));
+      return false;
+    }
 
     // Handle a code cell
     if (tmp->GetGroupType() == GC_TYPE_CODE)
@@ -5460,9 +5504,13 @@ bool Worksheet::ExportToHTML(wxString file)
               int bitmapScale = 3;
               ext = wxT(".png");
               wxConfig::Get()->Read(wxT("bitmapScale"), &bitmapScale);
-              size = CopyToFile(imgDir + wxT("/") + filename + wxString::Format(wxT("_%d.png"), count),
-                                &(*chunk),
-                                NULL, true, bitmapScale);
+              {
+                BitmapOut bmp(&m_configuration, bitmapScale);
+                bmp.SetData(CopySelection(&(*chunk), NULL, true));
+                wxImage image;
+                size = bmp.ToImage(image);
+                imageWriter.Add(image, imgDir + wxT("/") + filename + wxString::Format(wxT("_%d.png"), count));
+              }
               int borderwidth = 0;
               wxString alttext = EditorCell::EscapeHTMLChars(chunk->ListToString());
               borderwidth = chunk->m_imageBorderWidth;
@@ -5648,6 +5696,9 @@ bool Worksheet::ExportToHTML(wxString file)
 
   m_configuration->ClipToDrawRegion(true);
 
+  progress.Pulse(_("Waiting for the images to be written..."));
+  bool imagesOK = imageWriter.Finish();
+
   // Indent the document and test it for validity.
   wxXmlDocument doc;
   {
@@ -5689,7 +5740,7 @@ bool Worksheet::ExportToHTML(wxString file)
 
   m_configuration->ClipToDrawRegion(true);
   RecalculateForce();
-  return outfileOK && cssOK;
+  return outfileOK && cssOK && imagesOK;
 }
 
 void Worksheet::CodeCellVisibilityChanged()
@@ -5705,42 +5756,57 @@ void Worksheet::CodeCellVisibilityChanged()
   ScrollToCaret();
 }
 
-GroupCell *Worksheet::CreateTreeFromWXMCode(wxArrayString wxmLines)
+wxString Worksheet::WXMBlock(const wxArrayString &wxmLines, size_t &line, size_t end,
+                             const wxString &endMarker)
+{
+  // Skip the start marker
+  line++;
+
+  wxString contents;
+  while ((line < end) && (wxmLines[line] != endMarker))
+  {
+    if (contents.Length() == 0)
+      contents += wxmLines[line];
+    else
+      contents += wxT("\n") + wxmLines[line];
+
+    line++;
+  }
+  return contents;
+}
+
+GroupCell *Worksheet::CreateTreeFromWXMCode(const wxArrayString &wxmLines)
 {
   // Show a busy cursor as long as we export a .gif file (which might be a lengthy
   // action).
   wxBusyCursor crs;
+  return CreateTreeFromWXMCode(wxmLines, 0, wxmLines.GetCount());
+}
+
+GroupCell *Worksheet::CreateTreeFromWXMCode(const wxArrayString &wxmLines, size_t line, size_t end)
+{
   bool hide = false;
   GroupCell *tree = NULL;
   GroupCell *last = NULL;
   GroupCell *cell = NULL;
 
   wxString question;
-  
-  while (!wxmLines.IsEmpty())
+
+  // Instead of removing each line from the array after we have read it (which
+  // makes loading big files take quadratic time) we only move the index of
+  // the current line forward.
+  while (line < end)
   {
     cell = NULL;
 
-    if (wxmLines.Item(0) == wxT("/* [wxMaxima: hide output   ] */"))
+    if (wxmLines[line] == wxT("/* [wxMaxima: hide output   ] */"))
       hide = true;
 
       // Print title
-    else if (wxmLines.Item(0) == wxT("/* [wxMaxima: title   start ]"))
+    else if (wxmLines[line] == wxT("/* [wxMaxima: title   start ]"))
     {
-      wxmLines.RemoveAt(0);
-
-      wxString line;
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("   [wxMaxima: title   end   ] */")))
-      {
-        if (line.Length() == 0)
-          line += wxmLines.Item(0);
-        else
-          line += wxT("\n") + wxmLines.Item(0);
-
-        wxmLines.RemoveAt(0);
-      }
-
-      cell = new GroupCell(&m_configuration, GC_TYPE_TITLE, &m_cellPointers, line);
+      cell = new GroupCell(&m_configuration, GC_TYPE_TITLE, &m_cellPointers,
+                           WXMBlock(wxmLines, line, end, wxT("   [wxMaxima: title   end   ] */")));
       if (hide)
       {
         cell->Hide(true);
@@ -5749,22 +5815,10 @@ GroupCell *Worksheet::CreateTreeFromWXMCode(wxArrayString wxmLines)
     }
 
       // Print section
-    else if (wxmLines.Item(0) == wxT("/* [wxMaxima: section start ]"))
+    else if (wxmLines[line] == wxT("/* [wxMaxima: section start ]"))
     {
-      wxmLines.RemoveAt(0);
-
-      wxString line;
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("   [wxMaxima: section end   ] */")))
-      {
-        if (line.Length() == 0)
-          line += wxmLines.Item(0);
-        else
-          line += wxT("\n") + wxmLines.Item(0);
-
-        wxmLines.RemoveAt(0);
-      }
-
-      cell = new GroupCell(&m_configuration, GC_TYPE_SECTION, &m_cellPointers, line);
+      cell = new GroupCell(&m_configuration, GC_TYPE_SECTION, &m_cellPointers,
+                           WXMBlock(wxmLines, line, end, wxT("   [wxMaxima: section end   ] */")));
       if (hide)
       {
         cell->Hide(true);
@@ -5773,22 +5827,10 @@ GroupCell *Worksheet::CreateTreeFromWXMCode(wxArrayString wxmLines)
     }
 
       // Print subsection
-    else if (wxmLines.Item(0) == wxT("/* [wxMaxima: subsect start ]"))
+    else if (wxmLines[line] == wxT("/* [wxMaxima: subsect start ]"))
     {
-      wxmLines.RemoveAt(0);
-
-      wxString line;
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("   [wxMaxima: subsect end   ] */")))
-      {
-        if (line.Length() == 0)
-          line += wxmLines.Item(0);
-        else
-          line += wxT("\n") + wxmLines.Item(0);
-
-        wxmLines.RemoveAt(0);
-      }
-
-      cell = new GroupCell(&m_configuration, GC_TYPE_SUBSECTION, &m_cellPointers, line);
+      cell = new GroupCell(&m_configuration, GC_TYPE_SUBSECTION, &m_cellPointers,
+                           WXMBlock(wxmLines, line, end, wxT("   [wxMaxima: subsect end   ] */")));
       if (hide)
       {
         cell->Hide(true);
@@ -5797,22 +5839,10 @@ GroupCell *Worksheet::CreateTreeFromWXMCode(wxArrayString wxmLines)
     }
 
     // print subsubsection
-    else if (wxmLines.Item(0) == wxT("/* [wxMaxima: subsubsect start ]"))
+    else if (wxmLines[line] == wxT("/* [wxMaxima: subsubsect start ]"))
     {
-      wxmLines.RemoveAt(0);
-
-      wxString line;
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("   [wxMaxima: subsubsect end   ] */")))
-      {
-        if (line.Length() == 0)
-          line += wxmLines.Item(0);
-        else
-          line += wxT("\n") + wxmLines.Item(0);
-
-        wxmLines.RemoveAt(0);
-      }
-
-      cell = new GroupCell(&m_configuration, GC_TYPE_SUBSUBSECTION, &m_cellPointers, line);
+      cell = new GroupCell(&m_configuration, GC_TYPE_SUBSUBSECTION, &m_cellPointers,
+                           WXMBlock(wxmLines, line, end, wxT("   [wxMaxima: subsubsect end   ] */")));
       if (hide)
       {
         cell->Hide(true);
@@ -5821,22 +5851,10 @@ GroupCell *Worksheet::CreateTreeFromWXMCode(wxArrayString wxmLines)
     }
 
     // print heading5
-    else if (wxmLines.Item(0) == wxT("/* [wxMaxima: heading5 start ]"))
+    else if (wxmLines[line] == wxT("/* [wxMaxima: heading5 start ]"))
     {
-      wxmLines.RemoveAt(0);
-
-      wxString line;
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("   [wxMaxima: heading5 end   ] */")))
-      {
-        if (line.Length() == 0)
-          line += wxmLines.Item(0);
-        else
-          line += wxT("\n") + wxmLines.Item(0);
-
-        wxmLines.RemoveAt(0);
-      }
-
-      cell = new GroupCell(&m_configuration, GC_TYPE_HEADING5, &m_cellPointers, line);
+      cell = new GroupCell(&m_configuration, GC_TYPE_HEADING5, &m_cellPointers,
+                           WXMBlock(wxmLines, line, end, wxT("   [wxMaxima: heading5 end   ] */")));
       if (hide)
       {
         cell->Hide(true);
@@ -5845,22 +5863,10 @@ GroupCell *Worksheet::CreateTreeFromWXMCode(wxArrayString wxmLines)
     }
 
     // print heading6
-    else if (wxmLines.Item(0) == wxT("/* [wxMaxima: heading6 start ]"))
+    else if (wxmLines[line] == wxT("/* [wxMaxima: heading6 start ]"))
     {
-      wxmLines.RemoveAt(0);
-
-      wxString line;
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("   [wxMaxima: heading6 end   ] */")))
-      {
-        if (line.Length() == 0)
-          line += wxmLines.Item(0);
-        else
-          line += wxT("\n") + wxmLines.Item(0);
-
-        wxmLines.RemoveAt(0);
-      }
-
-      cell = new GroupCell(&m_configuration, GC_TYPE_HEADING6, &m_cellPointers, line);
+      cell = new GroupCell(&m_configuration, GC_TYPE_HEADING6, &m_cellPointers,
+                           WXMBlock(wxmLines, line, end, wxT("   [wxMaxima: heading6 end   ] */")));
       if (hide)
       {
         cell->Hide(true);
@@ -5869,22 +5875,10 @@ GroupCell *Worksheet::CreateTreeFromWXMCode(wxArrayString wxmLines)
     }
 
       // Print comment
-    else if (wxmLines.Item(0) == wxT("/* [wxMaxima: comment start ]"))
+    else if (wxmLines[line] == wxT("/* [wxMaxima: comment start ]"))
     {
-      wxmLines.RemoveAt(0);
-
-      wxString line;
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("   [wxMaxima: comment end   ] */")))
-      {
-        if (line.Length() == 0)
-          line += wxmLines.Item(0);
-        else
-          line += wxT("\n") + wxmLines.Item(0);
-
-        wxmLines.RemoveAt(0);
-      }
-
-      cell = new GroupCell(&m_configuration, GC_TYPE_TEXT, &m_cellPointers, line);
+      cell = new GroupCell(&m_configuration, GC_TYPE_TEXT, &m_cellPointers,
+                           WXMBlock(wxmLines, line, end, wxT("   [wxMaxima: comment end   ] */")));
       if (hide)
       {
         cell->Hide(true);
@@ -5893,24 +5887,12 @@ GroupCell *Worksheet::CreateTreeFromWXMCode(wxArrayString wxmLines)
     }
 
       // Print an image
-    else if (wxmLines.Item(0) == wxT("/* [wxMaxima: caption start ]"))
+    else if (wxmLines[line] == wxT("/* [wxMaxima: caption start ]"))
     {
-      wxmLines.RemoveAt(0);
-
-      wxString line;
-
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("   [wxMaxima: caption end   ] */")))
-      {
-        if (line.Length() == 0)
-          line += wxmLines.Item(0);
-        else
-          line += wxT("\n") + wxmLines.Item(0);
-
-        wxmLines.RemoveAt(0);
-      }
+      wxString caption = WXMBlock(wxmLines, line, end, wxT("   [wxMaxima: caption end   ] */"));
 
       cell = new GroupCell(&m_configuration, GC_TYPE_IMAGE, &m_cellPointers);
-      cell->GetEditable()->SetValue(line);
+      cell->GetEditable()->SetValue(caption);
 
       if (hide)
       {
@@ -5919,112 +5901,64 @@ GroupCell *Worksheet::CreateTreeFromWXMCode(wxArrayString wxmLines)
       }
 
       // Gracefully handle captions without images
-      if(wxmLines.IsEmpty())
+      if (line >= end)
         break;
 
-      wxmLines.RemoveAt(0);
-      if (wxmLines.Item(0) == wxT("/* [wxMaxima: image   start ]"))
+      line++;
+      if ((line < end) && (wxmLines[line] == wxT("/* [wxMaxima: image   start ]"))
       {
-        wxmLines.RemoveAt(0);
-
         // Read the image type
-        wxString imgtype = wxmLines.Item(0);
-        wxmLines.RemoveAt(0);
+        line++;
+        wxString imgtype;
+        if (line < end)
+          imgtype = wxmLines[line];
 
-        wxString ln;
-        while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("   [wxMaxima: image   end   ] */")))
-        {
-          if (ln.Length() == 0)
-            ln += wxmLines.Item(0);
-          else
-            ln += wxT("\n") + wxmLines.Item(0);
-
-          wxmLines.RemoveAt(0);
-        }
+        wxString ln = WXMBlock(wxmLines, line, end, wxT("   [wxMaxima: image   end   ] */"));
 
         cell->SetOutput(
           new ImgCell(NULL, &m_configuration, &m_cellPointers, wxBase64Decode(ln), imgtype));
       }
     }
       // Print input
-    else if (wxmLines.Item(0) == wxT("/* [wxMaxima: input   start ] */"))
+    else if (wxmLines[line] == wxT("/* [wxMaxima: input   start ] */"))
     {
-      wxmLines.RemoveAt(0);
-
-      wxString line;
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("/* [wxMaxima: input   end   ] */")))
-      {
-        if (line.Length() == 0)
-          line += wxmLines.Item(0);
-        else
-          line += wxT("\n") + wxmLines.Item(0);
-
-        wxmLines.RemoveAt(0);
-      }
-
-      cell = new GroupCell(&m_configuration, GC_TYPE_CODE, &m_cellPointers, line);
+      cell = new GroupCell(&m_configuration, GC_TYPE_CODE, &m_cellPointers,
+                           WXMBlock(wxmLines, line, end, wxT("/* [wxMaxima: input   end   ] */")));
       if (hide)
       {
         cell->Hide(true);
         hide = false;
       }
     }
-    if (wxmLines.Item(0) == wxT("/* [wxMaxima: answer  start ] */"))
+    if ((line < end) && (wxmLines[line] == wxT("/* [wxMaxima: answer  start ] */")))
     {
-      wxmLines.RemoveAt(0);
-
-      wxString line;
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("/* [wxMaxima: answer  end   ] */")))
-      {
-        if (line.Length() == 0)
-          line += wxmLines.Item(0);
-        else
-          line += wxT("\n") + wxmLines.Item(0);
-
-        wxmLines.RemoveAt(0);
-      }
+      wxString answer = WXMBlock(wxmLines, line, end, wxT("/* [wxMaxima: answer  end   ] */"));
       if((last != NULL) && (!question.IsEmpty()))
-        last->SetAnswer(question, line);
+        last->SetAnswer(question, answer);
     }
-    if (wxmLines.Item(0) == wxT("/* [wxMaxima: question  start ] */"))
-    {
-      wxmLines.RemoveAt(0);
-
-      wxString line;
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("/* [wxMaxima: question  end   ] */")))
-      {
-        if (line.Length() == 0)
-          line += wxmLines.Item(0);
-        else
-          line += wxT("\n") + wxmLines.Item(0);
-
-        wxmLines.RemoveAt(0);
-      }
-      question = line;
-    }
-    if (wxmLines.Item(0) == wxT("/* [wxMaxima: autoanswer    ] */"))
+    if ((line < end) && (wxmLines[line] == wxT("/* [wxMaxima: question  start ] */")))
+      question = WXMBlock(wxmLines, line, end, wxT("/* [wxMaxima: question  end   ] */"));
+    if ((line < end) && (wxmLines[line] == wxT("/* [wxMaxima: autoanswer    ] */")))
     {
       if(last != NULL)
         last->AutoAnswer(true);
     }
-    else if (wxmLines.Item(0) == wxT("/* [wxMaxima: page break    ] */"))
+    else if ((line < end) && (wxmLines[line] == wxT("/* [wxMaxima: page break    ] */")))
     {
-      wxmLines.RemoveAt(0);
+      line++;
 
       cell = new GroupCell(&m_configuration, GC_TYPE_PAGEBREAK, &m_cellPointers);
     }
 
-    else if (wxmLines.Item(0) == wxT("/* [wxMaxima: fold    start ] */"))
+    else if ((line < end) && (wxmLines[line] == wxT("/* [wxMaxima: fold    start ] */")))
     {
-      wxmLines.RemoveAt(0);
+      line++;
 
-      wxArrayString hiddenTree;
-      while ((!wxmLines.IsEmpty()) && (wxmLines.Item(0) != wxT("/* [wxMaxima: fold    end   ] */")))
-      {
-        hiddenTree.Add(wxmLines.Item(0));
-        wxmLines.RemoveAt(0);
-      }
-      last->HideTree(CreateTreeFromWXMCode(hiddenTree));
+      size_t foldStart = line;
+      while ((line < end) && (wxmLines[line] != wxT("/* [wxMaxima: fold    end   ] */")))
+        line++;
+      if (last != NULL)
+        last->HideTree(CreateTreeFromWXMCode(wxmLines, foldStart, line));
     }
 
     if (cell)
@@ -6041,8 +5975,8 @@ GroupCell *Worksheet::CreateTreeFromWXMCode(wxArrayString wxmLines)
       cell = NULL;
     }
 
-    if (!wxmLines.IsEmpty())
-      wxmLines.RemoveAt(0);
+    if (line < end)
+      line++;
   }
 
   return tree;
@@ -6070,7 +6004,10 @@ bool Worksheet::ExportToTeX(wxString file)
   if (!outfile.IsOk())
     return false;
 
-  wxTextOutputStream output(outfile);
+  // The document is written piece by piece => Collect the pieces in a buffer
+  // instead of issuing a write to the file for every single one of them.
+  wxBufferedOutputStream bufferedOutfile(outfile);
+  wxTextOutputStream output(bufferedOutfile);
 
   if(m_configuration->DocumentclassOptions().IsEmpty())
     output << "\\documentclass{" +
@@ -6160,9 +6097,12 @@ bool Worksheet::ExportToTeX(wxString file)
   //
   // Write contents
   //
+  // The images are numbered in the order they appear in the document, even
+  // if they are written to disk by background threads.
+  ParallelImageWriter imageWriter;
   while (tmp != NULL)
   {
-    wxString s = tmp->ToTeX(imgDir, filename, &imgCounter);
+    wxString s = tmp->ToTeX(imgDir, filename, &imgCounter, &imageWriter);
     output << s << wxT("\n");
     tmp = tmp->GetNext();
   }
@@ -6171,12 +6111,14 @@ bool Worksheet::ExportToTeX(wxString file)
   // Close document
   //
   output << wxT("\\end{document}\n");
+  output.Flush();
+  bufferedOutfile.Close();
 
-
+  bool imagesOK = imageWriter.Finish();
   bool done = !outfile.GetFile()->Error();
   outfile.Close();
 
-  return done;
+  return done && imagesOK;
 }
 
 wxString Worksheet::UnicodeToMaxima(wxString s)
@@ -6394,10 +6336,180 @@ bool Worksheet::ExportToWXMX(wxString file, bool markAsSaved)
       return false;
   }
 
-  wxFFileOutputStream out(backupfile);
-  if (!out.IsOk())
+  WXMXStartSave(file);
+  {
+    wxFFileOutputStream out(backupfile);
+    if (!out.IsOk())
+      return false;
+    wxZipOutputStream zip(out);
+
+    WriteWXMXHeader(zip);
+
+    // next zip entry is "content.xml", xml of GetTree()
+    zip.PutNextEntry(wxT("content.xml"));
+    if (!WriteWXMXContent(zip))
+    {
+      zip.Close();
+      out.Close();
+      wxRemoveFile(backupfile);
+      return false;
+    }
+
+    // Move all files we have stored in memory during saving to zip file
+    WXMXFiles files;
+    TakeWXMXFiles(files);
+    WriteWXMXFiles(zip, files);
+
+    // Copy the images that haven't changed since the last save from the old file
+    if (!CopyWXMXEntries(zip, file, m_cellPointers.m_wxmxReusedEntries))
+    {
+      zip.Close();
+      out.Close();
+      wxRemoveFile(backupfile);
+      wxLogMessage(_("Could not copy all unchanged images from the old file => saving all of them anew."));
+      WXMXSaveFinished(file, m_cellPointers.m_wxmxSaveId, false);
+      return ExportToWXMX(file, markAsSaved);
+    }
+
+    if (!zip.Close())
+      return false;
+    if (!out.Close())
+      return false;
+  }
+
+  bool saved = CommitWXMXFile(backupfile, file);
+  WXMXSaveFinished(file, m_cellPointers.m_wxmxSaveId, saved);
+  if (!saved)
+    return false;
+
+  if (markAsSaved)
+    SetSaved(true);
+
+  wxLogMessage(_("wxmx file saved"));
+  return true;
+}
+
+bool Worksheet::CreateWXMXSnapshot(wxString file, WXMXSnapshot &snapshot)
+{
+  WXMXStartSave(file);
+  wxMemoryOutputStream content;
+  if (!WriteWXMXContent(content))
     return false;
-  wxZipOutputStream zip(out);
+
+  size_t length = content.GetSize();
+  content.CopyTo(snapshot.m_content.GetWriteBuf(length), length);
+  snapshot.m_content.UngetWriteBuf(length);
+  TakeWXMXFiles(snapshot.m_files);
+  snapshot.m_reuseFrom = file;
+  snapshot.m_reusedEntries = m_cellPointers.m_wxmxReusedEntries;
+  snapshot.m_saveId = m_cellPointers.m_wxmxSaveId;
+  return true;
+}
+
+void Worksheet::WXMXSaveFinished(wxString file, long saveId, bool success)
+{
+  // If another save has been started in the meantime we don't know which
+  // images the file contains
+  if ((!success) || (saveId != m_cellPointers.m_wxmxSaveId) || (!wxFileExists(file)))
+  {
+    m_wxmxLastFile = wxEmptyString;
+    m_wxmxLastSaveId = 0;
+    return;
+  }
+  m_wxmxLastFile = file;
+  m_wxmxLastFileTime = wxFileModificationTime(file);
+  m_wxmxLastFileSize = wxFileName::GetSize(file);
+  m_wxmxLastSaveId = saveId;
+}
+
+void Worksheet::WXMXStartSave(wxString file)
+{
+  m_cellPointers.m_wxmxSaveId++;
+  m_cellPointers.m_wxmxReusedEntries.clear();
+  m_cellPointers.m_wxmxReuseSaveId = 0;
+
+  // Images can only be copied from the old file if nobody has changed it
+  // since we have saved it.
+  if ((m_wxmxLastSaveId != 0) && (file == m_wxmxLastFile) && wxFileExists(file) &&
+      (wxFileModificationTime(file) == m_wxmxLastFileTime) &&
+      (wxFileName::GetSize(file) == m_wxmxLastFileSize))
+    m_cellPointers.m_wxmxReuseSaveId = m_wxmxLastSaveId;
+}
+
+bool Worksheet::CopyWXMXEntries(wxZipOutputStream &zip, wxString oldFile,
+                                const std::map<wxString, bool> &entries)
+{
+  if (entries.empty())
+    return true;
+
+  size_t required = 0;
+  for (std::map<wxString, bool>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+    if (it->second)
+      required++;
+
+  wxFFileInputStream in(oldFile);
+  if (!in.IsOk())
+    return required == 0;
+  wxZipInputStream oldZip(in);
+
+  // CopyEntry() copies the compressed data as it is => images and gnuplot
+  // data don't need to be compressed again.
+  size_t found = 0;
+  std::unique_ptr<wxZipEntry> entry;
+  while (oldZip.IsOk())
+  {
+    entry.reset(oldZip.GetNextEntry());
+    if (!entry)
+      break;
+    std::map<wxString, bool>::const_iterator it = entries.find(entry->GetName());
+    if (it == entries.end())
+      continue;
+    if (it->second)
+      found++;
+    if (!zip.CopyEntry(entry.release(), oldZip))
+      return false;
+  }
+  return found == required;
+}
+
+bool Worksheet::WriteWXMXSnapshot(wxString file, const WXMXSnapshot &snapshot)
+{
+  wxString backupfile = file + wxT("~");
+  if (wxFileExists(backupfile))
+  {
+    if (!wxRemoveFile(backupfile))
+      return false;
+  }
+
+  {
+    wxFFileOutputStream out(backupfile);
+    if (!out.IsOk())
+      return false;
+    wxZipOutputStream zip(out);
+
+    WriteWXMXHeader(zip);
+    zip.PutNextEntry(wxT("content.xml"));
+    zip.Write(snapshot.m_content.GetData(), snapshot.m_content.GetDataLen());
+    WriteWXMXFiles(zip, snapshot.m_files);
+    if (!CopyWXMXEntries(zip, snapshot.m_reuseFrom, snapshot.m_reusedEntries))
+    {
+      zip.Close();
+      out.Close();
+      wxRemoveFile(backupfile);
+      return false;
+    }
+
+    if (!zip.Close())
+      return false;
+    if (!out.Close())
+      return false;
+  }
+
+  return CommitWXMXFile(backupfile, file);
+}
+
+void Worksheet::WriteWXMXHeader(wxZipOutputStream &zip)
+{
   wxTextOutputStream output(zip);
 
   /* The first zip entry is a file named "mimetype": This makes sure that the mimetype
@@ -6456,11 +6568,11 @@ bool Worksheet::ExportToWXMX(wxString file, bool markAsSaved)
     "from the XML file.\n\n"
     );
   zip.CloseEntry();
+}
 
-  // next zip entry is "content.xml", xml of GetTree()
-
-  zip.PutNextEntry(wxT("content.xml"));
-  wxString xmlText;
+bool Worksheet::WriteWXMXContent(wxOutputStream &stream)
+{
+  XmlStreamWriter xmlText(stream);
 
   xmlText << wxT("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
   xmlText << wxT("\n<!--   Created using wxMaxima ") << wxT(GITVERSION) << wxT("   -->");
@@ -6523,9 +6635,9 @@ bool Worksheet::ExportToWXMX(wxString file, bool markAsSaved)
   if(variables.GetCount() > 1)
   {
     long varcount = variables.GetCount() - 1;
-    xmlText += wxString::Format(" variables_num=\"%li\"", varcount);
+    xmlText << wxString::Format(" variables_num=\"%li\"", varcount);
     for(unsigned long i = 0; i<variables.GetCount(); i++)
-      xmlText += wxString::Format(" variables_%li=\"%s\"", i, Cell::XMLescape(variables[i]).utf8_str());
+      xmlText << wxString::Format(" variables_%li=\"%s\"", i, Cell::XMLescape(variables[i]).utf8_str());
   }
   
   xmlText << ">\n";
@@ -6533,26 +6645,49 @@ bool Worksheet::ExportToWXMX(wxString file, bool markAsSaved)
   // Reset image counter
   m_cellPointers.WXMXResetCounter();
 
-  if (GetTree())
-    xmlText += GetTree()->ListToXML();
+  // Write the XML of one cell after the other directly into the zip file
+  // instead of generating the whole document in memory first. Meanwhile we
+  // test if the XML can be read again before the user finds out the hard way.
+  wxString invalidXML;
+  for (GroupCell *cell = GetTree(); (cell != NULL) && xmlText.IsOk(); cell = cell->GetNext())
+  {
+    wxString cellXML = cell->ToXML();
+    xmlText << cellXML;
+    if (!xmlText.IsOk())
+      invalidXML = cellXML;
+  }
 
-  // Delete all but one control character from the string: there should be
-  // no way for them to enter this string, anyway. But sometimes they still
-  // do...
-  for (wxString::const_iterator it = xmlText.begin(); it != xmlText.end(); ++it)
+  xmlText <<  wxT("\n</wxMaximaDocument>");
+
+  // Don't keep the list of the images we have written in memory
+  m_cellPointers.WXMXResetCounter();
+
+  // If we have produced invalid XML we abort the save process as it will
+  // only destroy data.
+  // But we can still put the erroneous data into the clipboard for debugging purposes.
+  if (!xmlText.Finish())
   {
-    wxChar c = *it;
-    if ((c < wxT('\t')) ||
-        ((c > wxT('\n')) && (c < wxT(' '))) ||
-        (c == wxChar((char) 0x7F))
-      )
+    wxLogMessage(wxString::Format(_("Produced invalid XML: %s"), xmlText.GetError().utf8_str()));
+    if (wxTheClipboard->Open())
     {
-      // *it = wxT(' ');
+      wxDataObjectComposite *data = new wxDataObjectComposite;
+      data->Add(new wxTextDataObject(invalidXML));
+      wxTheClipboard->SetData(data);
+      wxTheClipboard->Close();
+      wxLogMessage(_("Produced invalid XML. The erroneous XML data has therefore not been saved but has been put on the clipboard in order to allow to debug it."));
     }
+
+    // Remove all files from our internal filesystem
+    WXMXFiles files;
+    TakeWXMXFiles(files);
+    return false;
   }
 
-  xmlText +=  wxT("\n</wxMaximaDocument>");
+  return true;
+}
 
+void Worksheet::TakeWXMXFiles(WXMXFiles &files)
+{
   // Prepare reading the files we have stored in memory
   std::unique_ptr<wxFileSystem> fsystem(new wxFileSystem);
   fsystem->AddHandler(new wxMemoryFSHandler);
@@ -6566,83 +6701,115 @@ bool Worksheet::ExportToWXMX(wxString file, bool markAsSaved)
                              dummyBuf.GetData(),
                              dummyBuf.GetDataLen());
 
-  // Let wxWidgets test if the document can be read again by the XML parser before
-  // the user finds out the hard way.
+  wxString memFsName = fsystem->FindFirst("*", wxFILE);
+  while(memFsName != wxEmptyString)
   {
-    wxXmlDocument doc;
-    {
-      wxMemoryOutputStream ostream;
-      wxTextOutputStream txtstrm(ostream);
-      txtstrm.WriteString(xmlText);
-      wxMemoryInputStream istream(ostream);
-      doc.Load(istream);
-    }
-
-    // If we fail to load the document we abort the safe process as it will
-    // only destroy data.
-    // But we can still put the erroneous data into the clipboard for debugging purposes.
-    if (!doc.IsOk())
+    wxString name = memFsName.Right(memFsName.Length()-7);
+    if(name != wxT("dummyfile"))
     {
-      if (wxTheClipboard->Open())
-      {
-        wxDataObjectComposite *data = new wxDataObjectComposite;
-        data->Add(new wxTextDataObject(xmlText));
-        wxTheClipboard->SetData(data);
-        wxLogMessage(_("Produced invalid XML. The erroneous XML data has therefore not been saved but has been put on the clipboard in order to allow to debug it."));
-      }
+      std::unique_ptr<wxFSFile> fsfile(fsystem->OpenFile(memFsName));
 
-      // Remove all files from our internal filesystem
-      wxString memFsName = fsystem->FindFirst("*", wxFILE);
-      while(memFsName != wxEmptyString)
+      if (fsfile)
       {
-        wxString name = memFsName.Right(memFsName.Length()-7);
-        wxMemoryFSHandler::RemoveFile(name);
-        memFsName = fsystem->FindNext();
+        wxMemoryBuffer contents;
+        std::unique_ptr<wxInputStream> input(fsfile->DetachStream());
+        wxMemoryOutputStream buffer;
+        input->Read(buffer);
+        size_t length = buffer.GetSize();
+        buffer.CopyTo(contents.GetWriteBuf(length), length);
+        contents.UngetWriteBuf(length);
+        files.push_back(std::make_pair(name, contents));
       }
-      return false;
     }
+    wxMemoryFSHandler::RemoveFile(name);
+    memFsName = fsystem->FindNext();
   }
+}
 
-  // wxWidgets could pretty-print the XML document now. But as no-one will
-  // look at it, anyway, there might be no good reason to do so.
-  if (GetTree() != NULL)output << xmlText;
+void Worksheet::WriteWXMXFiles(wxZipOutputStream &zip, const WXMXFiles &files)
+{
+  // The data for gnuplot is likely to change in its entirety if it
+  // ever changes => We can store it in a compressed form.
+  std::vector<const WXMXFiles::value_type *> toCompress;
+  for (WXMXFiles::const_iterator it = files.begin(); it != files.end(); ++it)
+    if(it->first.EndsWith(wxT(".data")))
+      toCompress.push_back(&(*it));
 
-  // Move all files we have stored in memory during saving to zip file
-  wxString memFsName = fsystem->FindFirst("*", wxFILE);
-  while(memFsName != wxEmptyString)
-  {
-    wxString name = memFsName.Right(memFsName.Length()-7);
-    if(name != wxT("dummyfile"))
-    {
-      zip.CloseEntry();
+  // Compressing at level 9 is slow => If there is more than one file to
+  // compress we compress them in parallel, each into a zip file of its own
+  // in memory, and then copy the compressed entries from there.
+  std::vector<wxMemoryBuffer> compressed;
+  if (toCompress.size() > 1)
+    CompressWXMXFiles(toCompress, compressed);
 
-      wxFSFile *fsfile = fsystem->OpenFile(memFsName);
+  size_t compressedIndex = 0;
+  for (WXMXFiles::const_iterator it = files.begin(); it != files.end(); ++it)
+  {
+    zip.CloseEntry();
 
-      if (fsfile)
+    if(it->first.EndsWith(wxT(".data")))
+    {
+      if (!compressed.empty())
       {
-        // The data for gnuplot is likely to change in its entirety if it
-        // ever changes => We can store it in a compressed form.
-        if(name.EndsWith(wxT(".data")))
-          zip.SetLevel(9);
-        else
-          zip.SetLevel(0);
-
-        zip.PutNextEntry(name);
-        std::unique_ptr<wxInputStream> imagefile(fsfile->GetStream());
-
-        while (!(imagefile->Eof()))
-          imagefile->Read(zip);
+        const wxMemoryBuffer &buffer = compressed[compressedIndex++];
+        wxMemoryInputStream in(buffer.GetData(), buffer.GetDataLen());
+        wxZipInputStream entryZip(in);
+        wxZipEntry *entry = entryZip.GetNextEntry();
+        if (entry != NULL)
+        {
+          zip.CopyEntry(entry, entryZip);
+          continue;
+        }
       }
+      zip.SetLevel(9);
     }
-    wxMemoryFSHandler::RemoveFile(name);
-    memFsName = fsystem->FindNext();
+    else
+      zip.SetLevel(0);
+
+    zip.PutNextEntry(it->first);
+    zip.Write(it->second.GetData(), it->second.GetDataLen());
   }
+  zip.SetLevel(0);
+}
 
-  if (!zip.Close())
-    return false;
-  if (!out.Close())
-    return false;
+void Worksheet::CompressWXMXFiles(const std::vector<const WXMXFiles::value_type *> &files,
+                                  std::vector<wxMemoryBuffer> &compressed)
+{
+  compressed.resize(files.size());
 
+  unsigned int numThreads = std::thread::hardware_concurrency();
+  if (numThreads < 1)
+    numThreads = 1;
+  if (numThreads > files.size())
+    numThreads = files.size();
+
+  // Each thread takes the next file nobody has compressed yet.
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < numThreads; i++)
+    threads.push_back(std::thread([&files, &compressed, &next]() {
+          size_t index;
+          while ((index = next++) < files.size())
+          {
+            wxMemoryOutputStream out;
+            {
+              wxZipOutputStream zip(out);
+              zip.SetLevel(9);
+              zip.PutNextEntry(files[index]->first);
+              zip.Write(files[index]->second.GetData(), files[index]->second.GetDataLen());
+              zip.Close();
+            }
+            size_t length = out.GetSize();
+            out.CopyTo(compressed[index].GetWriteBuf(length), length);
+            compressed[index].UngetWriteBuf(length);
+          }
+        }));
+  for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+    it->join();
+}
+
+bool Worksheet::CommitWXMXFile(wxString backupfile, wxString file)
+{
   // If all data is saved now we can overwrite the actual save file.
   // We will try to do so a few times if we suspect a MSW virus scanner or similar
   // temporarily hindering us from doing so.
@@ -6655,35 +6822,41 @@ bool Worksheet::ExportToWXMX(wxString file, bool markAsSaved)
 
   // Now we try to open the file in order to see if saving hasn't failed
   // without returning an error - which can apparently happen on MSW.
-  wxString wxmxURI = wxURI(wxT("file://") + backupfile).BuildURI();
-  wxmxURI.Replace("#", "%23");
-#ifdef  __WXMSW__
-  // Fixes a missing "///" after the "file:". This works because we always get absolute
-  // file names.
-  wxRegEx uriCorector1("^file:([a-zA-Z]):");
-  wxRegEx uriCorector2("^file:([a-zA-Z][a-zA-Z]):");
-  uriCorector1.ReplaceFirst(&wxmxURI,wxT("file:///\\1:"));
-  uriCorector2.ReplaceFirst(&wxmxURI,wxT("file:///\\1:"));
-#endif
-  // The URI of the wxm code contained within the .wxmx file
-  wxString filename = wxmxURI + wxT("#zip:content.xml");
-
-  // Open the file we have saved yet just in order to see if we
-  // actually managed to save it correctly.
+  // We read the zip file directly instead of using wxFileSystem as this
+  // function might be called from a background thread.
   {
-    wxFileSystem fs;
-    std::unique_ptr<wxFSFile> fsfile(fs.OpenFile(filename));
-    
+    wxFFileInputStream in(backupfile);
+    bool contentFound = false;
+    if (in.IsOk())
+    {
+      wxZipInputStream zip(in);
+      std::unique_ptr<wxZipEntry> entry;
+      while ((!contentFound) && zip.IsOk())
+      {
+        entry.reset(zip.GetNextEntry());
+        if (!entry)
+          break;
+        contentFound = (entry->GetName() == wxT("content.xml"));
+      }
+    }
+
     // Did we succeed in opening the file?
-    if (!fsfile)
+    if (!contentFound)
     {
       wxLogMessage(_(wxT("Saving succeeded, but the file could not be read again \u21D2 Not replacing the old saved file.")));
       return false;
-    }    
+    }
   }
-  
+
   {
-    SuppressErrorDialogs suppressor;
+    // SuppressErrorDialogs isn't thread-safe => In a background thread we
+    // just don't log errors here.
+    std::unique_ptr<SuppressErrorDialogs> suppressor;
+    std::unique_ptr<wxLogNull> noLog;
+    if (wxThread::IsMain())
+      suppressor.reset(new SuppressErrorDialogs);
+    else
+      noLog.reset(new wxLogNull);
     done = wxRenameFile(backupfile, file, true);
     if(!done)
     {
@@ -6708,10 +6881,6 @@ bool Worksheet::ExportToWXMX(wxString file, bool markAsSaved)
     if (!wxRenameFile(backupfile, file, true))
       return false;
   }
-  if (markAsSaved)
-    SetSaved(true);
-
-  wxLogMessage(_("wxmx file saved"));
   return true;
 }
 
@@ -7587,6 +7756,7 @@ void Worksheet::PasteFromClipboard()
           // Empty work sheet => We paste cells as the new cells
           m_tree = contents;
           m_last = end;
+          RegisterWordLists(contents);
         }
         else
         {
@@ -8432,46 +8602,7 @@ bool Worksheet::Autocomplete(AutoComplete::autoCompletionType type)
     }
   }
 
-  if (type == AutoComplete::command)
-  {
-    // Update the list of words that might not be defined as maxima function or variable
-    // but that still appear on the workSheet.
-    m_autocomplete->ClearWorksheetWords();
-    GroupCell *tmp = GetTree();
-    while (tmp != NULL)
-    {
-      // Don't collect the current word as possible autocompletion.
-      if (tmp != GetActiveCell()->GetGroup())
-      {
-        // Only collect words from Code Cells.
-        if ((tmp->GetGroupType() == GC_TYPE_CODE) && (tmp->GetEditable() != NULL))
-          m_autocomplete->AddWorksheetWords(tmp->GetEditable()->GetWordList());
-      }
-      else
-      {
-        if ((tmp->GetGroupType() == GC_TYPE_CODE) && (tmp->GetEditable() != NULL))
-        {
-          wxArrayString wordList = tmp->GetEditable()->GetWordList();
-
-          // The current unfinished word is no valid autocompletion, if there is
-          // such a thing.
-          if (partial.Length() > 0)
-          {
-            // Don't remove the current word from autocompletion if it never has been
-            // added (which happens if autocompletion is called when the cursor is
-            // directly followed by the next command without a space or similar inbetween)
-            if (wordList.Index(partial) != wxNOT_FOUND)
-              wordList.Remove(partial);
-          }
-          m_autocomplete->AddWorksheetWords(wordList);
-        }
-      }
-      tmp = tmp->GetNext();
-    }
-  }
-
   m_completions = m_autocomplete->CompleteSymbol(partial, type);
-  m_completions.Sort();
   m_autocompleteTemplates = (type == AutoComplete::tmplte);
 
   /// No completions - clear the selection and return false
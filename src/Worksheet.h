@@ -35,7 +35,10 @@
 #include <wx/textfile.h>
 #include <wx/fdrepdlg.h>
 #include <wx/dc.h>
+#include <wx/zipstrm.h>
 #include <list>
+#include <map>
+#include <vector>
 
 #include "VariablesPane.h"
 #include "Notification.h"
@@ -583,6 +586,74 @@ private:
   bool m_autocompleteTemplates;
   AutocompletePopup *m_autocompletePopup;
 
+  //! Writes the mimetype and format.txt entries every .wxmx file starts with
+  static void WriteWXMXHeader(wxZipOutputStream &zip);
+
+  /*! Writes the XML representation of the worksheet to a stream
+
+    Is used for the content.xml entry of .wxmx files. If the XML isn't well-formed
+    false is returned, nothing should be saved and the erroneous XML is put on the
+    clipboard instead.
+   */
+  bool WriteWXMXContent(wxOutputStream &stream);
+
+  /*! Prepares saving a .wxmx file
+
+    If the file hasn't changed since we saved it the last time the images that
+    haven't changed can be copied from the old file.
+   */
+  void WXMXStartSave(wxString file);
+
+  /*! Copies entries from an old .wxmx file without decompressing them
+
+    \retval false if an entry that needs to exist couldn't be found.
+   */
+  static bool CopyWXMXEntries(wxZipOutputStream &zip, wxString oldFile,
+                              const std::map<wxString, bool> &entries);
+
+  //! The .wxmx file we have saved to the last time
+  wxString m_wxmxLastFile;
+  //! The modification time of m_wxmxLastFile after we have saved it
+  time_t m_wxmxLastFileTime;
+  //! The size of m_wxmxLastFile after we have saved it
+  wxULongLong m_wxmxLastFileSize;
+  //! The number of the save that has written m_wxmxLastFile
+  long m_wxmxLastSaveId;
+
+  //! Moves the files WriteWXMXContent() has stored in the memory filesystem to a list
+  static void TakeWXMXFiles(WXMXFiles &files);
+
+  //! Writes the files TakeWXMXFiles() has collected to a .wxmx file
+  static void WriteWXMXFiles(wxZipOutputStream &zip, const WXMXFiles &files);
+
+  /*! Compresses files in parallel threads
+
+    \param files The files to compress
+    \param compressed Is filled with one zip file per file that contains only this file.
+   */
+  static void CompressWXMXFiles(const std::vector<const WXMXFiles::value_type *> &files,
+                                std::vector<wxMemoryBuffer> &compressed);
+
+  /*! Replaces a .wxmx file by the backup file the new version has been saved to
+
+    Tests if the backup file can be read again before doing so.
+   */
+  static bool CommitWXMXFile(wxString backupfile, wxString file);
+
+  //! Converts the lines [line, end) of a wxm description into individual cells
+  GroupCell *CreateTreeFromWXMCode(const wxArrayString &wxmLines, size_t line, size_t end);
+
+  /*! Reads the contents of a block of wxm code
+
+    \param wxmLines The lines of the wxm description
+    \param line The line the block's start marker is in. On return the line with
+                the end marker.
+    \param end The line after the last line of the wxm description
+    \param endMarker The line that ends the block
+   */
+  static wxString WXMBlock(const wxArrayString &wxmLines, size_t &line, size_t end,
+                           const wxString &endMarker);
+
 public:
   //! Is this worksheet empty?
   bool IsEmpty()
@@ -913,6 +984,14 @@ public:
   */
   GroupCell *InsertGroupCells(GroupCell *cells, GroupCell *where = NULL);
 
+  /*! Add the words of cells that enter the worksheet to the autocompletion's word list
+
+    Copies of cells (undo buffer, clipboard) don't count their words
+    until they are inserted into the worksheet.
+    \param cells The list of cells, including the cells folded into them
+  */
+  void RegisterWordLists(GroupCell *cells);
+
   /*! Add a new line to the output cell of the working group.
 
     If maxima isn't currently evaluating and therefore there is no working group
@@ -1116,6 +1195,48 @@ public:
   */
   bool ExportToWXMX(wxString file, bool markAsSaved = true);
 
+  //! The files a .wxmx file contains in addition to content.xml: name and contents
+  typedef std::list<std::pair<wxString, wxMemoryBuffer> > WXMXFiles;
+
+  //! A copy of everything that needs to be written to a .wxmx file
+  struct WXMXSnapshot
+  {
+    //! The UTF-8 encoded content.xml
+    wxMemoryBuffer m_content;
+    //! The images and the gnuplot sources
+    WXMXFiles m_files;
+    //! The file unchanged entries can be copied from
+    wxString m_reuseFrom;
+    //! The entries to copy from m_reuseFrom; true = the entry needs to exist
+    std::map<wxString, bool> m_reusedEntries;
+    //! The number of this save
+    long m_saveId;
+  };
+
+  /*! Makes a copy of the worksheet in the form it is saved in a .wxmx file
+
+    Writing this snapshot to a file doesn't need to access the worksheet which
+    means that it can be done in a background thread while the user continues
+    working. After it has been written WXMXSaveFinished() needs to be called.
+    \param file The file the snapshot will be written to
+    \param snapshot The snapshot to fill
+   */
+  bool CreateWXMXSnapshot(wxString file, WXMXSnapshot &snapshot);
+
+  /*! Needs to be called after a snapshot has been written to a .wxmx file
+
+    Remembers which images the file contains so the next save to the same file
+    can copy them instead of generating them anew.
+   */
+  void WXMXSaveFinished(wxString file, long saveId, bool success);
+
+  /*! Writes a snapshot created by CreateWXMXSnapshot() to a .wxmx file
+
+    Doesn't access the worksheet and can therefore be called from a background
+    thread.
+   */
+  static bool WriteWXMXSnapshot(wxString file, const WXMXSnapshot &snapshot);
+
   //! The start of a RTF document
   wxString RTFStart();
 
@@ -1425,6 +1546,10 @@ public:
   void AddSymbols(wxString xml)
   { m_autocomplete->AddSymbols(xml); }
 
+  //! Forget the symbols the last maxima process has told us about
+  void ClearLearnedSymbols()
+  { m_autocomplete->ClearLearnedSymbols(); }
+
   void SetActiveCellText(wxString text);
 
   bool InsertText(wxString text);
@@ -1462,7 +1587,7 @@ public:
   { return m_questionPrompt; }
   //!@}
   //! Converts a wxm description into individual cells
-  GroupCell *CreateTreeFromWXMCode(wxArrayString wxmLines);
+  GroupCell *CreateTreeFromWXMCode(const wxArrayString &wxmLines);
 
   /*! Does maxima wait for the answer of a question?
 
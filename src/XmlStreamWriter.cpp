@@ -0,0 +1,232 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2020 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*!\file
+
+  This file contains the class XmlStreamWriter that writes XML to a stream piece by piece
+ */
+
+#include "XmlStreamWriter.h"
+#include <wx/intl.h>
+
+XmlStreamWriter::XmlStreamWriter(wxOutputStream &stream) : m_output(stream)
+{
+  m_state = text;
+  m_quote = wxT('"');
+  m_lastChar = wxT(' ');
+  m_dashes = 0;
+}
+
+void XmlStreamWriter::Write(wxString xml)
+{
+  // Replace all control characters XML doesn't allow by spaces: there should be
+  // no way for them to enter this string, anyway. But sometimes they still
+  // do...
+  for (wxString::iterator it = xml.begin(); it != xml.end(); ++it)
+  {
+    wxChar c = *it;
+    if ((c < wxT('\t')) ||
+        ((c > wxT('\n')) && (c < wxT(' '))) ||
+        (c == wxChar((char) 0x7F))
+      )
+    {
+      *it = wxT(' ');
+      c = wxT(' ');
+    }
+    if (m_error.IsEmpty())
+      Check(c);
+  }
+  m_output << xml;
+}
+
+bool XmlStreamWriter::Finish()
+{
+  if (!m_error.IsEmpty())
+    return false;
+  if (m_state != text)
+    Error(_("The XML ends within a tag"));
+  else if (!m_openTags.empty())
+    Error(wxString::Format(_("Tag <%s> isn't closed"), m_openTags.back().utf8_str()));
+  return m_error.IsEmpty();
+}
+
+void XmlStreamWriter::Error(const wxString &error)
+{
+  if (m_error.IsEmpty())
+    m_error = error;
+}
+
+bool XmlStreamWriter::IsNameChar(wxChar c)
+{
+  return wxIsalnum(c) || (c == wxT('_')) || (c == wxT(':')) || (c == wxT('-')) ||
+    (c == wxT('.')) || (c >= 0x80);
+}
+
+void XmlStreamWriter::CloseTag()
+{
+  if (m_openTags.empty() || (m_openTags.back() != m_tagName))
+    Error(wxString::Format(_("Closing tag </%s> doesn't match the tag that is open"),
+                           m_tagName.utf8_str()));
+  else
+    m_openTags.pop_back();
+  m_state = text;
+}
+
+void XmlStreamWriter::Check(wxChar c)
+{
+  bool whitespace = (c == wxT(' ')) || (c == wxT('\t')) || (c == wxT('\n')) || (c == wxT('\r'));
+
+  switch (m_state)
+  {
+  case text:
+    if (c == wxT('<'))
+      m_state = tagStart;
+    else if (c == wxT('&'))
+    {
+      m_tagName = wxEmptyString;
+      m_state = entity;
+    }
+    break;
+  case entity:
+    if (c == wxT(';'))
+    {
+      if (m_tagName.IsEmpty())
+        Error(_("Empty entity"));
+      m_state = text;
+    }
+    else if (wxIsalnum(c) || (c == wxT('#')))
+      m_tagName += c;
+    else
+      Error(_("Unescaped \"&\""));
+    break;
+  case tagStart:
+    if (c == wxT('/'))
+    {
+      m_tagName = wxEmptyString;
+      m_state = endTagName;
+    }
+    else if (c == wxT('?'))
+      m_state = processingInstruction;
+    else if (c == wxT('!'))
+      m_state = declarationStart;
+    else if (IsNameChar(c) && (!wxIsdigit(c)) && (c != wxT('-')) && (c != wxT('.')))
+    {
+      m_tagName = c;
+      m_state = tagName;
+    }
+    else
+      Error(_("Unescaped \"<\""));
+    break;
+  case tagName:
+    if (IsNameChar(c))
+      m_tagName += c;
+    else if (whitespace)
+      m_state = tagBody;
+    else if (c == wxT('/'))
+      m_state = emptyTagEnd;
+    else if (c == wxT('>'))
+    {
+      m_openTags.push_back(m_tagName);
+      m_state = text;
+    }
+    else
+      Error(wxString::Format(_("Illegal character in the name of tag <%s>"), m_tagName.utf8_str()));
+    break;
+  case tagBody:
+    if ((c == wxT('"')) || (c == wxT('\'')))
+    {
+      m_quote = c;
+      m_state = attributeValue;
+    }
+    else if (c == wxT('/'))
+      m_state = emptyTagEnd;
+    else if (c == wxT('>'))
+    {
+      m_openTags.push_back(m_tagName);
+      m_state = text;
+    }
+    else if (c == wxT('<'))
+      Error(wxString::Format(_("Unterminated tag <%s>"), m_tagName.utf8_str()));
+    break;
+  case attributeValue:
+    if (c == m_quote)
+      m_state = tagBody;
+    else if (c == wxT('<'))
+      Error(wxString::Format(_("Unescaped \"<\" in an attribute of tag <%s>"), m_tagName.utf8_str()));
+    break;
+  case emptyTagEnd:
+    if (c == wxT('>'))
+      m_state = text;
+    else
+      Error(wxString::Format(_("\"/\" not followed by \">\" in tag <%s>"), m_tagName.utf8_str()));
+    break;
+  case endTagName:
+    if (IsNameChar(c))
+      m_tagName += c;
+    else if (whitespace)
+      m_state = endTagBody;
+    else if (c == wxT('>'))
+      CloseTag();
+    else
+      Error(wxString::Format(_("Illegal character in closing tag </%s>"), m_tagName.utf8_str()));
+    break;
+  case endTagBody:
+    if (c == wxT('>'))
+      CloseTag();
+    else if (!whitespace)
+      Error(wxString::Format(_("Illegal character in closing tag </%s>"), m_tagName.utf8_str()));
+    break;
+  case declarationStart:
+    if (c == wxT('-'))
+      m_state = commentStart;
+    else
+      m_state = declaration;
+    break;
+  case commentStart:
+    if (c == wxT('-'))
+    {
+      m_dashes = 0;
+      m_state = comment;
+    }
+    else
+      Error(_("Malformed comment"));
+    break;
+  case comment:
+    if (c == wxT('-'))
+      m_dashes++;
+    else
+    {
+      if ((c == wxT('>')) && (m_dashes >= 2))
+        m_state = text;
+      m_dashes = 0;
+    }
+    break;
+  case declaration:
+    if (c == wxT('>'))
+      m_state = text;
+    break;
+  case processingInstruction:
+    if ((c == wxT('>')) && (m_lastChar == wxT('?')))
+      m_state = text;
+    break;
+  }
+  m_lastChar = c;
+}
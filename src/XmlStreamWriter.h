@@ -0,0 +1,138 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2020 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*!\file
+
+  This file defines the class XmlStreamWriter that writes XML to a stream piece by piece
+ */
+
+#ifndef XMLSTREAMWRITER_H
+#define XMLSTREAMWRITER_H
+
+#include <wx/stream.h>
+#include <wx/txtstrm.h>
+#include <wx/string.h>
+#include <vector>
+
+/*! Writes XML to a stream piece by piece
+
+  Saving a .wxmx file used to generate the whole XML document in memory, to
+  parse it again using wxXmlDocument in order to make sure it can be read
+  again and only then to write it to the file. This class instead writes the
+  XML to the stream as soon as it is generated and meanwhile
+   - replaces the control characters XML doesn't allow by spaces and
+   - tests if the XML is well-formed (opening and closing tags match,
+     all "<" and "&" are part of a tag or an entity).
+  This check is much less thorough than what a real XML parser does, but
+  doesn't need to keep the document in memory.
+ */
+class XmlStreamWriter
+{
+public:
+  explicit XmlStreamWriter(wxOutputStream &stream);
+
+  /*! Writes a piece of XML to the stream
+
+    The piece doesn't need to be well-formed XML on its own: tags may begin
+    in one piece and end in the next one.
+   */
+  void Write(wxString xml);
+  XmlStreamWriter &operator<<(const wxString &xml)
+  {
+    Write(xml);
+    return *this;
+  }
+  XmlStreamWriter &operator<<(const wxChar *xml)
+  {
+    Write(xml);
+    return *this;
+  }
+  XmlStreamWriter &operator<<(const char *xml)
+  {
+    Write(xml);
+    return *this;
+  }
+  XmlStreamWriter &operator<<(long number)
+  {
+    Write(wxString::Format(wxT("%li"), number));
+    return *this;
+  }
+  XmlStreamWriter &operator<<(int number)
+  {
+    return *this << (long) number;
+  }
+
+  //! Tells if all XML written until now was well-formed
+  bool IsOk() const
+  { return m_error.IsEmpty(); }
+
+  //! Tests if the document is complete: All tags need to be closed again.
+  bool Finish();
+
+  //! A description of the first error we found in the XML
+  wxString GetError() const
+  { return m_error; }
+
+private:
+  //! The states of our parser
+  enum ParserState
+  {
+    text,           //!< Outside of any tag
+    entity,         //!< After a "&"
+    tagStart,       //!< After a "<"
+    tagName,        //!< Within the name of an opening tag
+    tagBody,        //!< Within an opening tag, after its name
+    attributeValue, //!< Within a quoted attribute value
+    emptyTagEnd,    //!< After the "/" of a "/>"
+    endTagName,     //!< Within the name of a closing tag
+    endTagBody,     //!< Within a closing tag, after its name
+    declarationStart, //!< After a "<!"
+    commentStart,   //!< After a "<!-"
+    comment,        //!< Within a comment
+    declaration,    //!< Within a "<!" that doesn't start a comment
+    processingInstruction //!< Within a "<?...?>"
+  };
+
+  //! Feeds one character to the parser
+  void Check(wxChar c);
+  //! Closes the tag m_tagName
+  void CloseTag();
+  //! Remembers the first error we found
+  void Error(const wxString &error);
+  static bool IsNameChar(wxChar c);
+
+  wxTextOutputStream m_output;
+  ParserState m_state;
+  //! The name of the tag we are currently in
+  wxString m_tagName;
+  //! The names of all tags that haven't been closed yet
+  std::vector<wxString> m_openTags;
+  //! The quotation mark the current attribute value started with
+  wxChar m_quote;
+  //! The last character we have seen (needed for "?>" and "-->")
+  wxChar m_lastChar;
+  //! The number of "-" in a row we have seen in a comment
+  int m_dashes;
+  //! The first error we have found
+  wxString m_error;
+};
+
+#endif // XMLSTREAMWRITER_H
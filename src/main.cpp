@@ -352,7 +352,8 @@ int MyApp::OnRun()
   return 0;
 }
 
-void MyApp::NewWindow(wxString file, bool evalOnStartup, bool exitAfterEval, unsigned char *wxmData, int wxmLen)
+void MyApp::NewWindow(wxString file, bool evalOnStartup, bool exitAfterEval, unsigned char *wxmData, int wxmLen,
+                      const wxString &wxmContents)
 {
   int numberOfWindows = m_topLevelWindows.size();
 
@@ -390,6 +391,8 @@ void MyApp::NewWindow(wxString file, bool evalOnStartup, bool exitAfterEval, uns
     initialContents += _(block);
     frame->SetWXMdata(initialContents);
   }
+  if (!wxmContents.IsEmpty())
+    frame->SetWXMdata(wxmContents);
   
   frame->ExitAfterEval(exitAfterEval);
   frame->EvalOnStartup(evalOnStartup);
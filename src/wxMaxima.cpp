@@ -76,6 +76,7 @@
 #include <wx/utils.h>
 #include <wx/uri.h>
 #include <wx/msgdlg.h>
+#include <wx/choicdlg.h>
 #include <wx/textfile.h>
 #include <wx/tokenzr.h>
 #include <wx/mimetype.h>
@@ -218,6 +219,12 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, wxLocale *locale, const wxString ti
   m_process = NULL;
   m_maximaStdout = NULL;
   m_maximaStderr = NULL;
+  m_compactOutput = false;
+  m_pipeMessagesDropped = 0;
+  m_stderrLinesDropped = 0;
+  m_outputOverflowMode = overflow_none;
+  m_outputOverflowChars = 0;
+  m_discardCellOutput = false;
   m_ready = false;
   m_first = true;
   m_dispReadOut = false;
@@ -240,6 +247,7 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, wxLocale *locale, const wxString ti
 
   m_closing = false;
   m_fileSaved = true;
+  m_autoSaveRunning = false;
 
   m_chmhelpFile = wxEmptyString;
 
@@ -742,6 +750,8 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, wxLocale *locale, const wxString ti
           wxCommandEventHandler(wxMaxima::EditInputMenu), NULL, this);
   Connect(menu_evaluate, wxEVT_MENU,
           wxCommandEventHandler(wxMaxima::EvaluateEvent), NULL, this);
+  Connect(autosave_finished_id, wxEVT_THREAD,
+          wxThreadEventHandler(wxMaxima::OnAutoSaveFinished), NULL, this);
   Connect(Variablespane::varID_newVar, wxEVT_MENU,
           wxCommandEventHandler(wxMaxima::VarReadEvent), NULL, this);
   Connect(Variablespane::varID_add_all, wxEVT_MENU,
@@ -822,6 +832,8 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, wxLocale *locale, const wxString ti
           wxCommandEventHandler(wxMaxima::PopupMenu), NULL, this);
   Connect(TableOfContents::popid_SelectTocChapter, wxEVT_MENU,
           wxCommandEventHandler(wxMaxima::PopupMenu), NULL, this);
+  Connect(TableOfContents::popid_EvalTocChapterSeparately, wxEVT_MENU,
+          wxCommandEventHandler(wxMaxima::PopupMenu), NULL, this);
   Connect(TableOfContents::popid_EvalTocChapter, wxEVT_MENU,
           wxCommandEventHandler(wxMaxima::PopupMenu), NULL, this);
   Connect(TableOfContents::popid_ToggleTOCshowsSectionNumbers, wxEVT_MENU,
@@ -1048,6 +1060,7 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, wxLocale *locale, const wxString ti
 
 wxMaxima::~wxMaxima()
 {
+  WaitForAutoSave();
   KillMaxima(false);
   MyApp::m_topLevelWindows.remove(this);
   if(MyApp::m_topLevelWindows.empty())
@@ -1212,6 +1225,14 @@ TextCell *wxMaxima::ConsoleAppend(wxString s, CellType type, wxString userLabel)
 
     while (s.Length() > 0)
     {
+      // Math in the compact format always arrives as one <cmth> block that
+      // MathParser decodes on its own.
+      if (s.StartsWith(wxT("<cmth>")))
+      {
+        DoConsoleAppend(s, type, false, true, userLabel);
+        break;
+      }
+
       int start = wxMax(s.Find(wxT("<mth")), s.Find(wxT("<math")));
 
       if (start == wxNOT_FOUND)
@@ -1455,6 +1476,46 @@ void wxMaxima::StripLispComments(wxString &s)
     m_blankStatementRegEx.Replace(&s, wxT(";"));
 }
 
+void wxMaxima::AddSymbolsFromCommands(wxString s)
+{
+  /// Check for function/variable definitions
+  wxStringTokenizer commands(s, wxT(";$"));
+  while (commands.HasMoreTokens())
+  {
+    wxString line = commands.GetNextToken();
+    if (m_varRegEx.Matches(line))
+      m_worksheet->AddSymbol(m_varRegEx.GetMatch(line, 1));
+
+    if (m_funRegEx.Matches(line))
+    {
+      wxString funName = m_funRegEx.GetMatch(line, 1);
+      m_worksheet->AddSymbol(funName);
+
+      /// Create a template from the input
+      wxString args = m_funRegEx.GetMatch(line, 2);
+      wxStringTokenizer argTokens(args, wxT(","));
+      funName << wxT("(");
+      int count = 0;
+      while (argTokens.HasMoreTokens())
+      {
+        if (count > 0)
+          funName << wxT(",");
+        wxString a = argTokens.GetNextToken().Trim().Trim(false);
+        if (a != wxEmptyString)
+        {
+          if (a[0] == '[')
+            funName << wxT("[<") << a.SubString(1, a.Length() - 2) << wxT(">]");
+          else
+            funName << wxT("<") << a << wxT(">");
+          count++;
+        }
+      }
+      funName << wxT(")");
+      m_worksheet->AddSymbol(funName, AutoComplete::tmplte);
+    }
+  }
+}
+
 void wxMaxima::SendMaxima(wxString s, bool addToHistory)
 {
   // Normally we catch parenthesis errors before adding cells to the
@@ -1483,42 +1544,7 @@ void wxMaxima::SendMaxima(wxString s, bool addToHistory)
     s.Trim(true);
     s.Append(wxT("\n"));
 
-    /// Check for function/variable definitions
-    wxStringTokenizer commands(s, wxT(";$"));
-    while (commands.HasMoreTokens())
-    {
-      wxString line = commands.GetNextToken();
-      if (m_varRegEx.Matches(line))
-        m_worksheet->AddSymbol(m_varRegEx.GetMatch(line, 1));
-
-      if (m_funRegEx.Matches(line))
-      {
-        wxString funName = m_funRegEx.GetMatch(line, 1);
-        m_worksheet->AddSymbol(funName);
-
-        /// Create a template from the input
-        wxString args = m_funRegEx.GetMatch(line, 2);
-        wxStringTokenizer argTokens(args, wxT(","));
-        funName << wxT("(");
-        int count = 0;
-        while (argTokens.HasMoreTokens())
-        {
-          if (count > 0)
-            funName << wxT(",");
-          wxString a = argTokens.GetNextToken().Trim().Trim(false);
-          if (a != wxEmptyString)
-          {
-            if (a[0] == '[')
-              funName << wxT("[<") << a.SubString(1, a.Length() - 2) << wxT(">]");
-            else
-              funName << wxT("<") << a << wxT(">");
-            count++;
-          }
-        }
-        funName << wxT(")");
-        m_worksheet->AddSymbol(funName, AutoComplete::tmplte);
-      }
-    }
+    AddSymbolsFromCommands(s);
 
     if ((m_client.IsConnected()) && (s.Length() >= 1))
     {
@@ -1590,35 +1616,231 @@ void wxMaxima::TryToReadDataFromMaxima()
   if (!m_client.IsConnected())
     return;
 
+  // While the user decides what to do with an overlong output we leave maxima's
+  // output in the socket's buffer which makes maxima wait for us.
+  if(m_outputOverflowMode == overflow_paused)
+    return;
+
   if(!m_client.IsData())
     return;
 
   m_statusBar->NetworkStatus(StatusBar::receive);
 
+  // Don't read more than we are willing to keep in memory: The rest stays in
+  // the socket's buffer and will be read as soon as we have interpreted or
+  // disposed of the data we already have.
+  size_t maxUnparsed = (size_t) m_worksheet->m_configuration->MaxUnparsedOutput() * 1000000;
+  size_t readLimit = 1024 * 1024;
+  if((m_outputOverflowMode == overflow_none) && (!m_first))
+  {
+    size_t buffered = m_currentOutput.Length() + m_newCharsFromMaxima.Length();
+    if(buffered < maxUnparsed)
+      readLimit = maxUnparsed - buffered;
+    else
+      readLimit = 0;
+  }
+  else if(m_first)
+    readLimit = maxUnparsed;
+
   // Read all new lines of text we received.
   wxChar chr;
+  size_t charsRead = 0;
 
-  while((m_client.IsConnected()) && (m_client.IsData()) && (m_clientStream != NULL) &&
+  while((charsRead < readLimit) &&
+        (m_client.IsConnected()) && (m_client.IsData()) && (m_clientStream != NULL) &&
         (!m_clientStream->Eof()))
   {
     chr = m_clientTextStream->GetChar();
     if(chr == wxEOT)
       break;
     if(chr != '\0')
+    {
       m_newCharsFromMaxima += chr;
+      charsRead++;
+    }
   }
+  // If we had to stop reading we won't get another wxSOCKET_INPUT event for the
+  // data that is left => make sure OnIdle() calls us again.
+  bool moreData = (charsRead >= readLimit) && (m_client.IsConnected()) && (m_client.IsData());
 
   if(m_pipeToStdout)
     std::cout << m_newCharsFromMaxima;
   m_bytesFromMaxima += m_newCharsFromMaxima.Length();
 
-  if(m_newCharsFromMaxima.EndsWith("\n") || m_newCharsFromMaxima.EndsWith(m_promptSuffix) || (m_first))
+  if((m_outputOverflowMode != overflow_none) && SinkOverflowingOutput())
+  {
+    if(moreData)
+      wxWakeUpIdle();
+    return;
+  }
+
+  if(m_newCharsFromMaxima.EndsWith("\n") || m_newCharsFromMaxima.EndsWith(m_promptSuffix) || (m_first) ||
+     (m_newCharsFromMaxima.Length() >= readLimit))
   {
     m_waitForStringEndTimer.Stop();
     InterpretDataFromMaxima();
   }
   else
     m_waitForStringEndTimer.StartOnce(5000);
+
+  if((m_outputOverflowMode == overflow_none) && (!m_first) &&
+     (m_currentOutput.Length() + m_newCharsFromMaxima.Length() >= maxUnparsed))
+    OnOutputOverflow();
+  else if(moreData)
+    wxWakeUpIdle();
+}
+
+wxMaxima::OutputOverflowMode wxMaxima::AskForOutputOverflowMode()
+{
+  wxArrayString choices;
+  choices.Add(_("Discard the rest of this output"));
+  choices.Add(_("Discard the rest of this output and mark it as truncated"));
+  choices.Add(_("Write the rest of this output to a file"));
+  wxSingleChoiceDialog dialog(
+    this,
+    wxString::Format(_("Maxima has sent more than %i million characters of output that cannot be displayed yet.\n"
+                       "What should happen to the output until maxima's next prompt?"),
+                     m_worksheet->m_configuration->MaxUnparsedOutput()),
+    _("Maxima's output is too long"), choices);
+  dialog.SetSelection(1);
+
+  OutputOverflowMode mode = overflow_truncate;
+  if(dialog.ShowModal() == wxID_OK)
+  {
+    switch(dialog.GetSelection())
+    {
+    case 0:
+      mode = overflow_discard;
+      break;
+    case 2:
+      mode = overflow_file;
+      break;
+    default:
+      mode = overflow_truncate;
+    }
+  }
+
+  if(mode == overflow_file)
+  {
+    wxFileDialog fileDialog(this,
+                            _("Save maxima's output as"), m_lastPath,
+                            wxT("maxima-output.xml"),
+                            _("XML (*.xml)|*.xml|All|*"),
+                            wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    mode = overflow_truncate;
+    if(fileDialog.ShowModal() == wxID_OK)
+    {
+      m_outputOverflowFileName = fileDialog.GetPath();
+      m_outputOverflowFile = std::unique_ptr<wxFileOutputStream>(
+        new wxFileOutputStream(m_outputOverflowFileName));
+      if(m_outputOverflowFile->IsOk())
+        mode = overflow_file;
+      else
+      {
+        m_outputOverflowFile.reset();
+        LoggingMessageBox(wxString::Format(_("Cannot write to %s. The output is discarded instead."),
+                                           m_outputOverflowFileName.utf8_str()),
+                          _("Error"), wxOK | wxICON_ERROR);
+      }
+    }
+  }
+  return mode;
+}
+
+void wxMaxima::OnOutputOverflow()
+{
+  m_outputOverflowMode = overflow_paused;
+  m_waitForStringEndTimer.Stop();
+  wxLogMessage(_("Maxima's output exceeds %i million characters without being complete."),
+               m_worksheet->m_configuration->MaxUnparsedOutput());
+
+  // In batch mode nobody is there to answer our questions.
+  OutputOverflowMode mode = overflow_truncate;
+  if(!m_exitAfterEval)
+    mode = AskForOutputOverflowMode();
+
+  // Maxima might have been killed or restarted while the dialogue was open.
+  if((!m_client.IsConnected()) || (m_first))
+  {
+    m_outputOverflowFile.reset();
+    m_outputOverflowMode = overflow_none;
+    return;
+  }
+
+  // Everything we haven't interpreted yet is part of the overlong output.
+  m_outputOverflowMode = mode;
+  m_outputOverflowChars = 0;
+  m_outputOverflowTail = wxEmptyString;
+  m_newCharsFromMaxima = m_currentOutput + m_newCharsFromMaxima;
+  m_currentOutput = wxEmptyString;
+  m_currentOutputEnd = wxEmptyString;
+  if(!SinkOverflowingOutput())
+    InterpretDataFromMaxima();
+  // The data that waits in the socket doesn't cause a new wxSOCKET_INPUT event
+  wxWakeUpIdle();
+}
+
+bool wxMaxima::SinkOverflowingOutput()
+{
+  wxString data = m_outputOverflowTail + m_newCharsFromMaxima;
+  m_newCharsFromMaxima = wxEmptyString;
+  m_outputOverflowTail = wxEmptyString;
+
+  int promptPos = data.Find(m_promptPrefix);
+  wxString sunk;
+  if(promptPos == wxNOT_FOUND)
+  {
+    // The prompt prefix might be split between this and the next chunk of data
+    size_t keep = wxMin(data.Length(), m_promptPrefix.Length());
+    sunk = data.Left(data.Length() - keep);
+    m_outputOverflowTail = data.Right(keep);
+  }
+  else
+  {
+    sunk = data.Left(promptPos);
+    m_newCharsFromMaxima = data.Right(data.Length() - promptPos);
+  }
+
+  m_outputOverflowChars += sunk.Length();
+  if(m_outputOverflowFile && (!sunk.IsEmpty()))
+  {
+    wxScopedCharBuffer buf = sunk.utf8_str();
+    m_outputOverflowFile->Write(buf.data(), buf.length());
+  }
+
+  if(promptPos == wxNOT_FOUND)
+    return true;
+
+  EndOutputOverflow();
+  return false;
+}
+
+void wxMaxima::EndOutputOverflow()
+{
+  TextCell *note = NULL;
+  switch(m_outputOverflowMode)
+  {
+  case overflow_truncate:
+    note = DoRawConsoleAppend(_("(Output truncated: it was longer than allowed by the configuration setting)"),
+                              MC_TYPE_WARNING);
+    break;
+  case overflow_file:
+    m_outputOverflowFile->Close();
+    note = DoRawConsoleAppend(wxString::Format(_("(Output written to %s)"),
+                                               m_outputOverflowFileName.utf8_str()),
+                              MC_TYPE_WARNING);
+    break;
+  default:
+    break;
+  }
+  if(note != NULL)
+    note->SetToolTip(_("The maximum size of an output wxMaxima accepts before asking what to do "
+                       "with it can be changed in the configuration dialogue."));
+  wxLogMessage(_("Disposed of %li characters of maxima's output."), m_outputOverflowChars);
+  m_outputOverflowFile.reset();
+  m_outputOverflowTail = wxEmptyString;
+  m_outputOverflowChars = 0;
+  m_outputOverflowMode = overflow_none;
 }
 
 
@@ -1803,6 +2025,8 @@ bool wxMaxima::StartMaxima(bool force)
                      dirname.utf8_str())
         );
   }
+  m_maximaInitialFolder = wxEmptyString;
+  wxGetEnv(wxT("MAXIMA_INITIAL_FOLDER"), &m_maximaInitialFolder);
 
   // We only need to start or restart maxima if we aren't connected to a maxima
   // that till now never has done anything and therefore is in perfect working
@@ -1818,7 +2042,9 @@ bool wxMaxima::StartMaxima(bool force)
 
     wxString command = GetCommand();
 
-    if (command.Length() > 0)
+    if (UseSpareMaxima(command))
+      StatusMaximaBusy(wait_for_start);
+    else if (command.Length() > 0)
     {
 
       command.Append(wxString::Format(wxT(" -s %d "), m_port));
@@ -1870,6 +2096,150 @@ bool wxMaxima::StartMaxima(bool force)
   return true;
 }
 
+void wxMaxima::KillSpareMaxima(const SpareMaxima &spare)
+{
+  long pid = spare.process->GetPid();
+  // A detached process doesn't inform us about its termination.
+  spare.process->Detach();
+  if (pid > 0)
+  {
+    SuppressErrorDialogs logNull;
+    wxProcess::Kill(pid, wxSIGKILL, wxKILL_CHILDREN);
+  }
+  spare.server->Destroy();
+}
+
+void wxMaxima::StartSpareMaximas()
+{
+  int poolSize = m_worksheet->m_configuration->MaximaPoolSize();
+
+  // If the pool has been made smaller we don't need all of our spare processes
+  // any more.
+  while ((int) m_spareMaximas.size() > poolSize)
+  {
+    KillSpareMaxima(m_spareMaximas.back());
+    m_spareMaximas.pop_back();
+  }
+
+  if ((int) m_spareMaximas.size() >= poolSize)
+    return;
+
+  wxString command = GetCommand();
+  if (command.IsEmpty())
+    return;
+
+  // The spare processes are to start in the same folder as the current one.
+  if (m_maximaInitialFolder.IsEmpty())
+    wxUnsetEnv(wxT("MAXIMA_INITIAL_FOLDER"));
+  else
+    wxSetEnv(wxT("MAXIMA_INITIAL_FOLDER"), m_maximaInitialFolder);
+  wxSetEnv(wxT("MAXIMA_SIGNALS_THREAD"), wxT("1"));
+
+  int port = m_port;
+  while ((int) m_spareMaximas.size() < poolSize)
+  {
+    SpareMaxima spare;
+    spare.server = NULL;
+    spare.port = port;
+    spare.command = command;
+    spare.initialFolder = m_maximaInitialFolder;
+
+    // Each spare maxima gets a server of its own so it cannot connect to the
+    // server of the maxima that is currently in use.
+    while ((spare.server == NULL) && (spare.port < 65535))
+    {
+      spare.port++;
+      bool portInUse = false;
+      for (std::list<SpareMaxima>::const_iterator it = m_spareMaximas.begin();
+           it != m_spareMaximas.end(); ++it)
+        if (it->port == spare.port)
+          portInUse = true;
+      if (portInUse)
+        continue;
+
+      wxIPV4address addr;
+      addr.AnyAddress();
+      addr.Service(spare.port);
+      spare.server = new wxSocketServer(addr, wxSOCKET_NOWAIT|wxSOCKET_REUSEADDR);
+      if (!spare.server->Ok())
+      {
+        spare.server->Destroy();
+        spare.server = NULL;
+      }
+    }
+    if (spare.server == NULL)
+    {
+      wxLogMessage(_("Cannot find a free port for a spare maxima."));
+      return;
+    }
+    port = spare.port;
+
+    spare.process = new wxProcess(this, maxima_process_id);
+    spare.process->Redirect();
+    wxString spareCommand = command + wxString::Format(wxT(" -s %d "), spare.port);
+    wxLogMessage(wxString::Format(_("Starting a spare maxima as: %s"), spareCommand.utf8_str()));
+    if (wxExecute(spareCommand, wxEXEC_ASYNC, spare.process) <= 0)
+    {
+      wxLogMessage(_("Cannot start a spare maxima."));
+      spare.server->Destroy();
+      return;
+    }
+    m_spareMaximas.push_back(spare);
+  }
+}
+
+bool wxMaxima::UseSpareMaxima(const wxString &command)
+{
+  wxString initialFolder;
+  wxGetEnv(wxT("MAXIMA_INITIAL_FOLDER"), &initialFolder);
+
+  while (!m_spareMaximas.empty())
+  {
+    SpareMaxima spare = m_spareMaximas.front();
+    m_spareMaximas.pop_front();
+
+    if ((spare.command != command) || (spare.initialFolder != initialFolder) ||
+        (!wxProcess::Exists(spare.process->GetPid())))
+    {
+      wxLogMessage(_("Discarding a spare maxima that doesn't match the current settings."));
+      KillSpareMaxima(spare);
+      continue;
+    }
+
+    wxLogMessage(wxString::Format(_("Using the spare maxima that listens on port %d"), spare.port));
+    // Maxima has connected to the spare's server, and maybe has done so long
+    // ago => take over this server and accept the connection.
+    if (m_server != NULL)
+      m_server->Destroy();
+    m_server = spare.server;
+    m_port = spare.port;
+    m_server->SetEventHandler(*GetEventHandler());
+    m_server->SetNotify(wxSOCKET_CONNECTION_FLAG);
+    m_server->Notify(true);
+    m_server->SetTimeout(30);
+
+    m_process = spare.process;
+    m_first = true;
+    m_pid = -1;
+    m_maximaStdout = m_process->GetInputStream();
+    m_maximaStderr = m_process->GetErrorStream();
+    m_lastPrompt = wxT("(%i1) ");
+    m_pollForConnectionTimer.Start(300);
+    m_maximaConnectTimeout.StartOnce(8000);
+    return true;
+  }
+  return false;
+}
+
+void wxMaxima::KillSpareMaximas()
+{
+  while (!m_spareMaximas.empty())
+  {
+    KillSpareMaxima(m_spareMaximas.front());
+    m_spareMaximas.pop_front();
+  }
+}
+
 
 void wxMaxima::Interrupt(wxCommandEvent& WXUNUSED(event))
 {
@@ -1882,6 +2252,10 @@ void wxMaxima::Interrupt(wxCommandEvent& WXUNUSED(event))
     return;
   }
 
+  // The commands we have sent in advance shouldn't run after the interrupted
+  // one. Maxima reads this as soon as it is back at its prompt.
+  FlushCommandsAhead();
+
 #if defined (__WXMSW__)
   if(m_pid > 0)
   {
@@ -2032,9 +2406,12 @@ void wxMaxima::KillMaxima(bool logMessage)
   m_configCommands = wxEmptyString;
   // The new maxima process will be in its initial condition => mark it as such.
   m_hasEvaluatedCells = false;
+  // ...and won't know the functions and variables the old one has defined.
+  m_worksheet->ClearLearnedSymbols();
 
   m_worksheet->m_cellPointers.SetWorkingGroup(NULL);
   m_worksheet->m_evaluationQueue.Clear();
+  m_worksheet->m_evaluationQueue.ClearCommandsInFlight();
   EvaluationQueueLength(0);
 
   // We start checking for maximas output again as soon as we send some data to the program.
@@ -2042,6 +2419,9 @@ void wxMaxima::KillMaxima(bool logMessage)
   m_CWD = wxEmptyString;
   m_worksheet->QuestionAnswered();
   m_currentOutput = wxEmptyString;
+  m_discardCellOutput = false;
+  if ((m_outputOverflowMode != overflow_none) && (m_outputOverflowMode != overflow_paused))
+    EndOutputOverflow();
   // If we did close maxima by hand we already might have a new process
   // and therefore invalidate the wrong process in this step
   if (m_process)
@@ -2049,6 +2429,13 @@ void wxMaxima::KillMaxima(bool logMessage)
   m_process = NULL;
   m_maximaStdout = NULL;
   m_maximaStderr = NULL;
+  // Bytes of a character the old process didn't finish writing
+  m_stdoutBytes.SetDataLen(0);
+  m_stderrBytes.SetDataLen(0);
+  // ...and the messages of the old process that still wait for being displayed
+  m_pipeMessages.clear();
+  m_pipeMessagesDropped = 0;
+  m_stderrLinesDropped = 0;
 
   m_clientTextStream = NULL;
   m_clientStream = NULL;
@@ -2106,8 +2493,23 @@ void wxMaxima::OnGnuplotClose(wxProcessEvent& WXUNUSED(event))
   wxLogMessage(_("Gnuplot has closed."));
 }
 
-void wxMaxima::OnProcessEvent(wxProcessEvent& WXUNUSED(event))
+void wxMaxima::OnProcessEvent(wxProcessEvent& event)
 {
+  // A spare maxima that has died on its own is simply forgotten about.
+  for (std::list<SpareMaxima>::iterator it = m_spareMaximas.begin();
+       it != m_spareMaximas.end(); ++it)
+  {
+    if ((event.GetPid() > 0) && (it->process->GetPid() == event.GetPid()))
+    {
+      wxLogMessage(_("A spare maxima has terminated."));
+      it->server->Destroy();
+      // We receive this event instead of the process => we have to delete it.
+      delete it->process;
+      m_spareMaximas.erase(it);
+      return;
+    }
+  }
+
   wxLogMessage(_("Maxima has terminated."));
   m_rawDataToSend.Clear();
   m_rawBytesSent = 0;
@@ -2141,6 +2543,7 @@ void wxMaxima::OnProcessEvent(wxProcessEvent& WXUNUSED(event))
       StartMaxima(true);
     }
     m_worksheet->m_evaluationQueue.Clear();
+    m_worksheet->m_evaluationQueue.ClearCommandsInFlight();
   }
   StatusMaximaBusy(disconnected);
   wxUpdateUIEvent dummy;
@@ -2150,6 +2553,7 @@ void wxMaxima::OnProcessEvent(wxProcessEvent& WXUNUSED(event))
 
 void wxMaxima::CleanUp()
 {
+  KillSpareMaximas();
   if (m_client.IsConnected())
     KillMaxima();
 }
@@ -2206,11 +2610,16 @@ void wxMaxima::ReadFirstPrompt(wxString &data)
     EvaluationQueueLength(0);
     if (m_evalOnStartup)
     {
-      wxLogMessage(_("Starting evaluation of the document"));
-      m_evalOnStartup = false;
-      m_worksheet->AddDocumentToEvaluationQueue();
-      EvaluationQueueLength(m_worksheet->m_evaluationQueue.Size(), m_worksheet->m_evaluationQueue.CommandsLeftInCell());
-      TriggerEvaluation();
+      // If the worksheet still is to be populated OnIdle() starts the
+      // evaluation as soon as that has happened.
+      if (m_initialWorkSheetContents.IsEmpty())
+      {
+        wxLogMessage(_("Starting evaluation of the document"));
+        m_evalOnStartup = false;
+        m_worksheet->AddDocumentToEvaluationQueue();
+        EvaluationQueueLength(m_worksheet->m_evaluationQueue.Size(), m_worksheet->m_evaluationQueue.CommandsLeftInCell());
+        TriggerEvaluation();
+      }
     }
     else
     {
@@ -2223,17 +2632,23 @@ void wxMaxima::ReadFirstPrompt(wxString &data)
   }
   else
     TriggerEvaluation();
+
+  // Now that the current maxima is ready we can afford to start the next ones.
+  if (!m_exitAfterEval)
+    StartSpareMaximas();
 }
 
 int wxMaxima::GetMiscTextEnd(const wxString &data)
 {
   // These tests are redundant with later tests. But they are faster.
-  if(data.StartsWith("<mth>") || (data.StartsWith("<math>")))
+  if(data.StartsWith("<mth>") || (data.StartsWith("<math>")) || (data.StartsWith("<cmth>")))
     return 0;
   if(data.StartsWith("<lbl>"))
     return 0;
   if(data.StartsWith("<statusbar>"))
     return 0;
+  if(data.StartsWith("<cell-id>"))
+    return 0;
   if(data.StartsWith(m_promptPrefix))
     return 0;
   if(data.StartsWith(m_symbolsPrefix))
@@ -2246,8 +2661,10 @@ int wxMaxima::GetMiscTextEnd(const wxString &data)
     return 0;
 
   int mthpos = wxMax(data.Find("<mth>"), data.Find("<math>"));
+  int cmthpos = data.Find("<cmth>");
   int lblpos = data.Find("<lbl>");
   int statpos = data.Find("<statusbar>");
+  int cellidpos = data.Find("<cell-id>");
   int prmptpos = data.Find(m_promptPrefix);
   int symbolspos = data.Find(m_symbolsPrefix);
   int suppressOutputPos = data.Find(m_suppressOutputPrefix);
@@ -2257,10 +2674,14 @@ int wxMaxima::GetMiscTextEnd(const wxString &data)
   int tagPos = data.Length();
   if ((mthpos != wxNOT_FOUND) && (mthpos < tagPos))
     tagPos = mthpos;
+  if ((cmthpos != wxNOT_FOUND) && (cmthpos < tagPos))
+    tagPos = cmthpos;
   if ((tagPos == wxNOT_FOUND) || ((lblpos != wxNOT_FOUND) && (lblpos < tagPos)))
     tagPos = lblpos;
   if ((tagPos == wxNOT_FOUND) || ((statpos != wxNOT_FOUND) && (statpos < tagPos)))
     tagPos = statpos;
+  if ((tagPos == wxNOT_FOUND) || ((cellidpos != wxNOT_FOUND) && (cellidpos < tagPos)))
+    tagPos = cellidpos;
   if ((tagPos == wxNOT_FOUND) || ((prmptpos != wxNOT_FOUND) && (prmptpos < tagPos)))
     tagPos = prmptpos;
   if ((tagPos == wxNOT_FOUND) || ((prmptpos != wxNOT_FOUND) && (prmptpos < tagPos)))
@@ -2292,6 +2713,8 @@ void wxMaxima::ReadMiscText(wxString &data)
 
   wxString miscText = data.Left(miscTextLen);
   data = data.Right(data.Length() - miscTextLen);
+  if (m_discardCellOutput)
+    return;
 
   // Stupid DOS and MAC line endings. The first of these commands won't work
   // if the "\r" is the last char of a packet containing a part of a very long
@@ -2425,12 +2848,58 @@ void wxMaxima::ReadStatusBar(wxString &data)
   }
 }
 
+void wxMaxima::ReadCellID(wxString &data)
+{
+  wxString cellIDStart = wxT("<cell-id>");
+  if (!data.StartsWith(cellIDStart))
+    return;
+
+  wxString cellIDEnd = wxT("</cell-id>");
+  int end;
+  if ((end = FindTagEnd(data,cellIDEnd)) != wxNOT_FOUND)
+  {
+    m_worksheet->m_cellPointers.m_currentTextCell = NULL;
+    long id;
+    GroupCell *cell = NULL;
+    if (data.SubString(cellIDStart.Length(), end - 1).ToLong(&id))
+      cell = m_worksheet->m_cellPointers.GetCellByID(id);
+    m_worksheet->m_cellPointers.SetWorkingGroup(cell);
+    // The output for a cell that has been deleted would otherwise end up in
+    // whatever cell GetWorkingGroup(true) falls back to.
+    m_discardCellOutput = (cell == NULL);
+    // Remove the cell id from the data string
+    data = data.Right(data.Length()-end-cellIDEnd.Length());
+  }
+}
+
+void wxMaxima::SendOutputFormat()
+{
+  // The XML inspector is meant for debugging => it always gets XML.
+  bool compact = m_worksheet->m_configuration->CompactOutput() &&
+    (!((m_xmlInspector) && (IsPaneDisplayed(menu_pane_xmlInspector))));
+  if (compact == m_compactOutput)
+    return;
+
+  m_compactOutput = compact;
+  if (compact)
+    SendMaxima(wxT(":lisp-quiet (setq *wx-compact-output* t)\n"));
+  else
+    SendMaxima(wxT(":lisp-quiet (setq *wx-compact-output* nil)\n"));
+}
+
+void wxMaxima::SendCellID(GroupCell *cell)
+{
+  SendMaxima(wxString::Format(wxT(":lisp-quiet (wx-cell-id %li)\n"),
+                              m_worksheet->m_cellPointers.GetCellID(cell)));
+}
+
 /***
  * Checks if maxima displayed a new chunk of math
  */
 void wxMaxima::ReadMath(wxString &data)
 {
-  if ((!data.StartsWith("<mth>")) && (!data.StartsWith("<math>")))
+  if ((!data.StartsWith("<mth>")) && (!data.StartsWith("<math>")) &&
+      (!data.StartsWith("<cmth>")))
     return;
 
   m_worksheet->m_cellPointers.m_currentTextCell = NULL;
@@ -2438,8 +2907,14 @@ void wxMaxima::ReadMath(wxString &data)
   // Append everything from the "beginning of math" to the "end of math" marker
   // to the console and remove it from the data we got.
   int mthTagLen;
-  int end = FindTagEnd(data,"</mth>");
-  if(end >= 0)
+  int end;
+  if(data.StartsWith("<cmth>"))
+  {
+    // Math in the compact format, see SendOutputFormat()
+    end = FindTagEnd(data,"</cmth>");
+    mthTagLen = 7;
+  }
+  else if((end = FindTagEnd(data,"</mth>")) >= 0)
     mthTagLen = 6;
   else
   {
@@ -2452,7 +2927,7 @@ void wxMaxima::ReadMath(wxString &data)
     data = data.Right(data.Length() - end - mthTagLen);
     o.Trim(true);
     o.Trim(false);
-    if (o.Length() > 0)
+    if ((o.Length() > 0) && (!m_discardCellOutput))
     {
       if (m_worksheet->m_configuration->UseUserLabels())
       {
@@ -2514,6 +2989,8 @@ void wxMaxima::ReadVariables(wxString &data)
     wxXmlNode *node = xmldoc.GetRoot();
     if(node != NULL)
     {
+      // Redraw the variables pane only once after all values are updated.
+      m_worksheet->m_variablesPane->BeginBatch();
       wxXmlNode *vars = node->GetChildren();
       while (vars != NULL)
       {
@@ -2521,7 +2998,10 @@ void wxMaxima::ReadVariables(wxString &data)
 
         wxString name;
         wxString value;
+        wxString hash;
+        long size = -1;
         bool bound = false;
+        bool unchanged = false;
         while(var != NULL)
         {
           if(var->GetName() == wxT("name"))
@@ -2540,7 +3020,26 @@ void wxMaxima::ReadVariables(wxString &data)
               value = valnode->GetContent();
             }
           }
+          if(var->GetName() == wxT("size"))
+          {
+            wxXmlNode *sizenode = var->GetChildren();
+            if((!sizenode) || (!sizenode->GetContent().ToLong(&size)))
+              size = -1;
+          }
+          if(var->GetName() == wxT("hash"))
+          {
+            wxXmlNode *hashnode = var->GetChildren();
+            if(hashnode)
+              hash = hashnode->GetContent();
+          }
+          // Maxima tells us that the value hasn't changed since we last got it
+          if(var->GetName() == wxT("unchanged"))
+            unchanged = true;
+          var = var->GetNext();
+        }
 
+        if(!unchanged)
+        {
           if(bound)
           {
             if(name == "maxima_userdir")
@@ -2601,15 +3100,14 @@ void wxMaxima::ReadVariables(wxString &data)
               m_recentPackages.AddDocument(value);
               wxLogMessage(wxString::Format(_("Maxima has loaded the file %s."),value.utf8_str()));
             }
-            m_worksheet->m_variablesPane->VariableValue(name, value);
+            m_worksheet->m_variablesPane->VariableValue(name, value, hash, size);
           }
           else
             m_worksheet->m_variablesPane->VariableUndefined(name);
-
-          var = var->GetNext();
         }
         vars = vars->GetNext();
       }
+      m_worksheet->m_variablesPane->EndBatch();
     }
 
     if(num>1)
@@ -2673,9 +3171,15 @@ bool wxMaxima::QueryVariableValue()
 
   if(m_varNamesToQuery.GetCount() > 0)
   {
-    SendMaxima(wxT(":lisp-quiet (wx-query-variable \"") +
-               m_varNamesToQuery.Last()+wxT("\")\n"));
-    m_varNamesToQuery.RemoveAt(m_varNamesToQuery.GetCount()-1);
+    // Query all variables at once: Each query costs a round-trip to maxima.
+    // They are passed as one list: Lisps limit the number of arguments a
+    // function can be called with.
+    wxString command = wxT(":lisp-quiet (wx-query-variables '(");
+    for(size_t i = 0; i < m_varNamesToQuery.GetCount(); i++)
+      command += wxT(" ") + m_worksheet->m_variablesPane->QueryArgument(m_varNamesToQuery[i]);
+    command += wxT("))\n");
+    m_varNamesToQuery.Clear();
+    SendMaxima(command);
     return true;
   }
   else
@@ -2741,8 +3245,11 @@ void wxMaxima::ReadPrompt(wxString &data)
   {
     // Maxima displayed a new main prompt => We don't have a question
     m_worksheet->QuestionAnswered();
-    // And we can remove one command from the evaluation queue.
-    m_worksheet->m_evaluationQueue.RemoveFirst();
+    m_discardCellOutput = false;
+    // And we can remove one command from the evaluation queue - unless it was
+    // sent in advance and has left the queue since.
+    if (m_worksheet->m_evaluationQueue.CommandFinished())
+      m_worksheet->m_evaluationQueue.RemoveFirst();
 
     //m_lastPrompt = o.Mid(1,o.Length()-1);
     //m_lastPrompt.Replace(wxT(")"), wxT(":"), false);
@@ -2751,7 +3258,16 @@ void wxMaxima::ReadPrompt(wxString &data)
     // if we remove a command from the evaluation queue the next output line will be the
     // first from the next command.
     m_outputCellsFromCurrentCommand = 0;
-    if (m_worksheet->m_evaluationQueue.Empty())
+    if (m_worksheet->m_evaluationQueue.LeftQueueCommandInFlight())
+    {
+      // Maxima now works on a command we have sent in advance, but that isn't
+      // part of the queue any more => discard its output and wait for its prompt.
+      m_ready = false;
+      m_maximaBusy = true;
+      m_worksheet->m_cellPointers.SetWorkingGroup(NULL);
+      m_discardCellOutput = true;
+    }
+    else if (m_worksheet->m_evaluationQueue.Empty())
     { // queue empty.
       m_exitOnError = false;
       StatusMaximaBusy(waiting);
@@ -2797,6 +3313,9 @@ void wxMaxima::ReadPrompt(wxString &data)
   }
   else
   {  // We have a question
+    // Questions are remembered and parsed as XML.
+    if (o.Find(wxT("<cmth>")) >= 0)
+      o = MathParser::CompactToXml(o);
     m_worksheet->SetLastQuestion(o);
     m_worksheet->QuestionAnswered();
     m_worksheet->QuestionPending(true);
@@ -2899,10 +3418,10 @@ wxString wxMaxima::ReadMacContents(wxString file)
 {
   bool xMaximaFile = file.Lower().EndsWith(wxT(".out"));
 
-    // open mac file
-  wxTextFile inputFile(file);
+  // open mac file
+  wxFileInputStream inputFile(file);
 
-  if (!inputFile.Open())
+  if (!inputFile.IsOk())
   {
     LoggingMessageBox(_("wxMaxima encountered an error loading ") + file, _("Error"), wxOK | wxICON_EXCLAMATION);
     StatusMaximaBusy(waiting);
@@ -2910,11 +3429,20 @@ wxString wxMaxima::ReadMacContents(wxString file)
     return wxEmptyString;
   }
 
+  wxTextInputStream text(inputFile, wxT('\t'), wxConvAuto(wxFONTENCODING_UTF8));
+
   bool input = true;
   wxString macContents;
-  wxString line = inputFile.GetFirstLine();
-  do
+  // Reserving the memory the file's contents will need at once avoids
+  // re-allocating the string over and over again for big files.
+  if (inputFile.GetLength() > 0)
+    macContents.reserve(inputFile.GetLength());
+  while (inputFile.IsOk() && !inputFile.Eof())
   {
+    wxString line = text.ReadLine();
+    if (inputFile.Eof() && (line == wxEmptyString))
+      break;
+
     if(xMaximaFile)
     {
       // Detect output cells.
@@ -2934,13 +3462,11 @@ wxString wxMaxima::ReadMacContents(wxString file)
     }
 
     if(input)
-      macContents += line + wxT("\n");
-
-    if(!inputFile.Eof())
-      line = inputFile.GetNextLine();
-
-  } while (!inputFile.Eof());
-  inputFile.Close();
+    {
+      macContents += line;
+      macContents += wxT('\n');
+    }
+  }
 
   return macContents;
 }
@@ -2961,7 +3487,27 @@ bool wxMaxima::OpenMACFile(wxString file, Worksheet *document, bool clearDocumen
   if (clearDocument)
     document->ClearDocument();
 
+  // All cells are collected in a list that is inserted into the worksheet at
+  // once: Inserting each cell on its own means recalculating, renumbering the
+  // sections and creating an undo action for every single cell.
+  GroupCell *tree = NULL;
   GroupCell *last = NULL;
+  auto appendCells = [&tree, &last](GroupCell *cells)
+    {
+      if (cells == NULL)
+        return;
+      if (tree == NULL)
+        tree = cells;
+      else
+      {
+        last->m_next = last->m_nextToDraw = cells;
+        cells->m_previous = last;
+      }
+      last = cells;
+      while (last->m_next != NULL)
+        last = last->GetNext();
+    };
+
   wxString line = wxEmptyString;
   wxChar lastChar = wxT(' ');
   wxString::const_iterator ch = macContents.begin();
@@ -3074,17 +3620,11 @@ bool wxMaxima::OpenMACFile(wxString file, Worksheet *document, bool clearDocumen
             commentLines.Add(tokenizer.GetNextToken());
 
           // Interpret this array of lines as wxm code.
-          GroupCell *cell;
-          document->InsertGroupCells(
-            cell = m_worksheet->CreateTreeFromWXMCode(commentLines),
-            last);
-          last = cell;
+          appendCells(m_worksheet->CreateTreeFromWXMCode(commentLines));
 
         }
           else
         {
-          GroupCell *cell;
-
           if((line.StartsWith("/* ")) || (line.StartsWith("/*\n")))
             line = line.SubString(3,line.length()-1);
           else
@@ -3095,12 +3635,9 @@ bool wxMaxima::OpenMACFile(wxString file, Worksheet *document, bool clearDocumen
           else
             line = line.SubString(0,line.length()-3);
 
-          document->InsertGroupCells(
-            cell = new GroupCell(&(document->m_configuration),
-                                 GC_TYPE_TEXT, &document->m_cellPointers,
-                                 line),
-            last);
-          last = cell;
+          appendCells(new GroupCell(&(document->m_configuration),
+                                    GC_TYPE_TEXT, &document->m_cellPointers,
+                                    line));
         }
 
         line = wxEmptyString;
@@ -3109,23 +3646,30 @@ bool wxMaxima::OpenMACFile(wxString file, Worksheet *document, bool clearDocumen
     // Handle strings
     else if((*ch == '\"') )
     {
-      // Skip to the end of the string
+      // Skip to the end of the string: A ";" or a "$" within a string doesn't
+      // end a command.
+      line += *ch;
+      ++ch;
       while (ch != macContents.end())
       {
-        line += *ch;
-
-        if ((*ch == wxT('\"')))
+        wxChar c = *ch;
+        line += c;
+        ++ch;
+        if ((c == wxT('\\')) && (ch != macContents.end()))
         {
-          lastChar = *ch;
-          if(ch != macContents.end())
-            ++ch;
-          break;
+          line += *ch;
+          ++ch;
         }
+        else if (c == wxT('\"'))
+          break;
       }
+      lastChar = wxT('\"');
     }
     // Handle escaped chars
     else if((*ch == '\\') )
     {
+      line += *ch;
+      ++ch;
       if(ch != macContents.end())
       {
         line += *ch;
@@ -3142,12 +3686,8 @@ bool wxMaxima::OpenMACFile(wxString file, Worksheet *document, bool clearDocumen
       {
         line.Trim(true);
         line.Trim(false);
-        GroupCell *cell;
-        document->InsertGroupCells(
-          cell = new GroupCell(&(document->m_configuration),
-                        GC_TYPE_CODE, &document->m_cellPointers, line),
-          last);
-        last = cell;
+        appendCells(new GroupCell(&(document->m_configuration),
+                                  GC_TYPE_CODE, &document->m_cellPointers, line));
         line = wxEmptyString;
       }
       lastChar = *ch;
@@ -3159,12 +3699,10 @@ bool wxMaxima::OpenMACFile(wxString file, Worksheet *document, bool clearDocumen
   line.Trim(true);
   line.Trim(false);
   if(line != wxEmptyString)
-  {
-    document->InsertGroupCells(
-      new GroupCell(&(document->m_configuration),
-                    GC_TYPE_CODE, &document->m_cellPointers, line),
-      last);
-  }
+    appendCells(new GroupCell(&(document->m_configuration),
+                              GC_TYPE_CODE, &document->m_cellPointers, line));
+
+  document->InsertGroupCells(tree);
 
   if (clearDocument)
   {
@@ -3204,10 +3742,10 @@ bool wxMaxima::OpenWXMFile(wxString file, Worksheet *document, bool clearDocumen
   wxWindowUpdateLocker noUpdates(document);
 
   // open wxm file
-  wxTextFile inputFile(file);
+  wxFileInputStream input(file);
   wxArrayString wxmLines;
 
-  if (!inputFile.Open())
+  if (!input.IsOk())
   {
     LoggingMessageBox(_("wxMaxima encountered an error loading ") + file, _("Error"), wxOK | wxICON_EXCLAMATION);
     StatusMaximaBusy(waiting);
@@ -3215,23 +3753,23 @@ bool wxMaxima::OpenWXMFile(wxString file, Worksheet *document, bool clearDocumen
     return false;
   }
 
-  if (inputFile.GetFirstLine() !=
-      wxT("/* [wxMaxima batch file version 1] [ DO NOT EDIT BY HAND! ]*/"))
+  wxTextInputStream text(input, wxT('\t'), wxConvAuto(wxFONTENCODING_UTF8));
+  wxString line = text.ReadLine();
+  if (line != wxT("/* [wxMaxima batch file version 1] [ DO NOT EDIT BY HAND! ]*/"))
   {
-    inputFile.Close();
     LoggingMessageBox(_("wxMaxima encountered an error loading ") + file, _("Error"), wxOK | wxICON_EXCLAMATION);
     return false;
   }
-  wxString line;
-  for (line = inputFile.GetFirstLine();
-       !inputFile.Eof();
-       line = inputFile.GetNextLine())
+
+  // Read the file line by line directly into the array the worksheet is
+  // generated from instead of keeping a second copy of all lines in memory.
+  wxmLines.Add(line);
+  while (input.IsOk() && !input.Eof())
   {
-    wxmLines.Add(line);
+    line = text.ReadLine();
+    if ((!input.Eof()) || (line != wxEmptyString))
+      wxmLines.Add(line);
   }
-  wxmLines.Add(line);
-
-  inputFile.Close();
 
   GroupCell *tree = m_worksheet->CreateTreeFromWXMCode(wxmLines);
 
@@ -3637,6 +4175,8 @@ void wxMaxima::SetupVariables()
   wxLogMessage(_("Sending maxima the info how to express 2d maths as XML"));
   wxMathML wxmathml;
   SendMaxima(wxmathml.GetCmd());
+  // A new maxima starts with sending XML.
+  m_compactOutput = false;
   wxString cmd;
 
 #if defined (__WXOSX__)
@@ -4016,23 +4556,17 @@ bool wxMaxima::InterpretDataFromMaxima()
 
     length_old = m_currentOutput.Length();
 
-    GroupCell *oldActiveCell = NULL;
-    GroupCell *newActiveCell = NULL;
-
     // Handle text that isn't wrapped in a known tag
     if (!m_first)
     {
       // First read the prompt that tells us that maxima awaits the next command:
       // If that is the case ReadPrompt() sends the next command to maxima and
       // maxima can work while we interpret its output.
-      oldActiveCell = m_worksheet->GetWorkingGroup();
       ReadPrompt(m_currentOutput);
-      newActiveCell = m_worksheet->GetWorkingGroup();
 
-      // Temporarily switch to the WorkingGroup the output we don't have interpreted yet
-      // was for
-      if(newActiveCell != oldActiveCell)
-        m_worksheet->m_cellPointers.SetWorkingGroup(oldActiveCell);
+      // Maxima tells us which cell the following output is for.
+      ReadCellID(m_currentOutput);
+
       // Handle the <mth> tag that contains math output and sometimes text.
       ReadMath(m_currentOutput);
 
@@ -4060,10 +4594,6 @@ bool wxMaxima::InterpretDataFromMaxima()
       // This function determines the port maxima is running on from  the text
       // maxima outputs at startup. This piece of text is afterwards discarded.
       ReadFirstPrompt(m_currentOutput);
-
-    // Switch to the WorkingGroup the next bunch of data is for.
-    if(newActiveCell != oldActiveCell)
-      m_worksheet->m_cellPointers.SetWorkingGroup(newActiveCell);
   }
   return true;
 }
@@ -4098,7 +4628,7 @@ void wxMaxima::OnIdle(wxIdleEvent &event)
     if(!m_initialWorkSheetContents.IsEmpty())
     {
       //  Convert the comment block to an array of lines
-      wxStringTokenizer tokenizer(m_initialWorkSheetContents, "\n");
+      wxStringTokenizer tokenizer(m_initialWorkSheetContents, "\n", wxTOKEN_RET_EMPTY_ALL);
       wxArrayString lines;
       while ( tokenizer.HasMoreTokens() )
         lines.Add(tokenizer.GetNextToken());
@@ -4106,6 +4636,15 @@ void wxMaxima::OnIdle(wxIdleEvent &event)
         m_worksheet->CreateTreeFromWXMCode(lines));
       m_worksheet->SetSaved(true);
       m_initialWorkSheetContents = wxEmptyString;
+      // If maxima was faster than us the evaluation on startup is still pending.
+      if (m_evalOnStartup && (!m_first))
+      {
+        wxLogMessage(_("Starting evaluation of the document"));
+        m_evalOnStartup = false;
+        m_worksheet->AddDocumentToEvaluationQueue();
+        EvaluationQueueLength(m_worksheet->m_evaluationQueue.Size(), m_worksheet->m_evaluationQueue.CommandsLeftInCell());
+        TriggerEvaluation();
+      }
     }
   }
   // Update the info what maxima is currently doing
@@ -4724,6 +5263,7 @@ bool wxMaxima::OpenFile(wxString file, wxString command)
   }
 
   UpdateRecentDocuments();
+  WaitForAutoSave();
   RemoveTempAutosavefile();
   m_autoSaveTimer.StartOnce(180000);
 
@@ -4766,6 +5306,9 @@ bool wxMaxima::SaveFile(bool forceSave)
   // Show a busy cursor as long as we export a file.
   wxBusyCursor crs;
 
+  // Don't write to the file while an autosave might be doing the same.
+  WaitForAutoSave();
+
   wxString file = m_worksheet->m_currentFile;
   wxString fileExt = wxT("wxmx");
   int ext = 0;
@@ -4887,58 +5430,195 @@ void wxMaxima::ReadStdErr()
   // If something is severely broken this might not be true, though, and we want
   // to inform the user about it.
 
-  if (m_process == NULL) return;
-
-  if (m_process->IsInputAvailable())
+  if (m_process != NULL)
   {
-    wxASSERT_MSG(m_maximaStdout != NULL, wxT("Bug: Trying to read from maxima but don't have a input stream"));
-    wxTextInputStream istrm(*m_maximaStdout, wxT('\t'), wxConvAuto(wxFONTENCODING_UTF8));
-    wxString o;
-    wxChar ch;
-    while (((ch = istrm.GetChar()) != wxT('\0')) && (m_maximaStdout->CanRead()))
-      o += ch;
+    if (m_process->IsInputAvailable())
+    {
+      wxASSERT_MSG(m_maximaStdout != NULL, wxT("Bug: Trying to read from maxima but don't have a input stream"));
+      ReadPipe(m_maximaStdout, m_stdoutBytes, false);
+    }
+    if (m_process->IsErrorAvailable())
+    {
+      wxASSERT_MSG(m_maximaStderr != NULL, wxT("Bug: Trying to read from maxima but don't have a error input stream"));
+      ReadPipe(m_maximaStderr, m_stderrBytes, true);
+    }
+  }
+  DisplayPipeMessages();
+}
 
-    wxString o_trimmed = o;
-    o_trimmed.Trim();
+void wxMaxima::ReadPipe(wxInputStream *stream, wxMemoryBuffer &pending, bool isError)
+{
+  // Once it has read something wxInputStream::Read() returns instead of
+  // waiting for more data => we can read in big chunks without blocking.
+  char buffer[4096];
+  size_t bytesRead = 0;
+  while ((bytesRead < MAXIMAPIPEBYTES) && (stream->CanRead()))
+  {
+    stream->Read(buffer, sizeof(buffer));
+    size_t len = stream->LastRead();
+    if (len == 0)
+      break;
+    pending.AppendData(buffer, len);
+    bytesRead += len;
+  }
+
+  // Keep the bytes of a multi-byte character whose end we haven't read yet
+  // for the next time.
+  const unsigned char *data = (const unsigned char *) pending.GetData();
+  size_t len = pending.GetDataLen();
+  size_t complete = len;
+  size_t lead = len;
+  while ((lead > 0) && (len - lead < 3) && ((data[lead - 1] & 0xC0) == 0x80))
+    lead--;
+  if ((lead > 0) && (data[lead - 1] >= 0xC0))
+  {
+    size_t charLen = 2;
+    if (data[lead - 1] >= 0xF0)
+      charLen = 4;
+    else if (data[lead - 1] >= 0xE0)
+      charLen = 3;
+    if (lead - 1 + charLen > len)
+      complete = lead - 1;
+  }
+  if (complete == 0)
+    return;
 
-    o = _("Message from the stdout of Maxima: ") + o;
-    if ((o_trimmed != wxEmptyString) && (!o.StartsWith("Connecting Maxima to server on port")) &&
-        (!m_first))
+  wxString text((const char *) data, wxConvUTF8, complete);
+  if (text.IsEmpty())
+    text = wxString((const char *) data, wxConvISO8859_1, complete);
+  wxMemoryBuffer rest;
+  rest.AppendData(data + complete, len - complete);
+  pending = rest;
+
+  QueuePipeMessage(text, isError);
+}
+
+void wxMaxima::QueuePipeMessage(wxString text, bool isError)
+{
+  // Lisp compilers tend to repeat the same warning over and over again.
+  wxString coalesced;
+  wxString lastLine;
+  long repeats = 0;
+  wxStringTokenizer lines(text, wxT("\n"), wxTOKEN_RET_DELIMS);
+  while (lines.HasMoreTokens())
+  {
+    wxString line = lines.GetNextToken();
+    wxString line_trimmed = line;
+    line_trimmed.Trim();
+    if ((line == lastLine) && (!line_trimmed.IsEmpty()))
+      repeats++;
+    else
     {
-      DoRawConsoleAppend(o, MC_TYPE_DEFAULT);
-      if(m_pipeToStdout)
-        std::cout << o;
+      if (repeats > 0)
+        coalesced += wxString::Format(_("[The line above was repeated %li times]\n"), repeats);
+      coalesced += line;
+      lastLine = line;
+      repeats = 0;
     }
   }
-  if (m_process->IsErrorAvailable())
+  if (repeats > 0)
+    coalesced += wxString::Format(_("[The line above was repeated %li times]\n"), repeats);
+
+  wxString coalesced_trimmed = coalesced;
+  coalesced_trimmed.Trim();
+  bool showAsError = isError &&
+    (coalesced != wxT("End of animation sequence")) &&
+    (!coalesced.Contains("frames in animation sequence")) &&
+    (!coalesced_trimmed.IsEmpty());
+  if (showAsError)
+  {
+    m_worksheet->m_cellPointers.m_errorList.Add(m_worksheet->GetWorkingGroup(true));
+    AbortOnError();
+    TriggerEvaluation();
+  }
+
+  if ((!m_pipeMessages.empty()) && (m_pipeMessages.back().text == coalesced) &&
+      (m_pipeMessages.back().isError == isError))
+  {
+    m_pipeMessages.back().repeats++;
+    return;
+  }
+
+  if (m_pipeMessages.size() >= MAXPIPEMESSAGES)
+  {
+    // The evaluation already has been aborted, if needed => we only need to
+    // tell the user how much of maxima's stderr output hasn't been shown.
+    if (isError)
+      m_stderrLinesDropped += coalesced_trimmed.Freq(wxT('\n')) + 1;
+    else
+      m_pipeMessagesDropped++;
+    return;
+  }
+
+  PipeMessage message;
+  message.text = coalesced;
+  message.isError = isError;
+  message.showAsError = showAsError;
+  message.repeats = 0;
+  m_pipeMessages.push_back(message);
+}
+
+void wxMaxima::DisplayPipeMessages()
+{
+  // Each message creates cells that need to be laid out => If maxima floods
+  // us with messages we display them bit by bit so the GUI stays responsive.
+  wxStopWatch stopwatch;
+  while ((!m_pipeMessages.empty()) && (stopwatch.Time() < 100))
   {
-    wxASSERT_MSG(m_maximaStderr != NULL, wxT("Bug: Trying to read from maxima but don't have a error input stream"));
-    wxTextInputStream istrm(*m_maximaStderr, wxT('\t'), wxConvAuto(wxFONTENCODING_UTF8));
-    wxString o;
-    wxChar ch;
-    while (((ch = istrm.GetChar()) != wxT('\0')) && (m_maximaStderr->CanRead()))
-      o += ch;
+    PipeMessage message = m_pipeMessages.front();
+    m_pipeMessages.pop_front();
 
+    wxString o = message.text;
     wxString o_trimmed = o;
     o_trimmed.Trim();
+    if (message.repeats > 0)
+      o += wxString::Format(_("\n[This message was repeated %li times]"), message.repeats);
 
-    o = wxT("Message from maxima's stderr stream: ") + o;
-
-    if((o != wxT("Message from maxima's stderr stream: End of animation sequence")) &&
-       !o.Contains("frames in animation sequence") && (o_trimmed != wxEmptyString) &&
-       (o.Length() > 1))
+    if (!message.isError)
     {
-      DoRawConsoleAppend(o, MC_TYPE_ERROR);
-      AbortOnError();
-      TriggerEvaluation();
-      m_worksheet->m_cellPointers.m_errorList.Add(m_worksheet->GetWorkingGroup(true));
-      
-      if(m_pipeToStdout)
-        std::cout << o;
+      if ((o_trimmed != wxEmptyString) &&
+          (!message.text.StartsWith("Connecting Maxima to server on port")) &&
+          (!m_first))
+      {
+        o = _("Message from the stdout of Maxima: ") + o;
+        DoRawConsoleAppend(o, MC_TYPE_DEFAULT);
+        if(m_pipeToStdout)
+          std::cout << o;
+      }
     }
     else
-      DoRawConsoleAppend(o, MC_TYPE_DEFAULT);
+    {
+      o = wxT("Message from maxima's stderr stream: ") + o;
+
+      // QueuePipeMessage() has already aborted the evaluation, if needed.
+      if (message.showAsError)
+      {
+        DoRawConsoleAppend(o, MC_TYPE_ERROR);
+        if(m_pipeToStdout)
+          std::cout << o;
+      }
+      else
+        DoRawConsoleAppend(o, MC_TYPE_DEFAULT);
+    }
+  }
+
+  if (m_pipeMessages.empty() && (m_pipeMessagesDropped > 0))
+  {
+    DoRawConsoleAppend(wxString::Format(_("%li further messages from maxima's stdout "
+                                          "have been dropped."), m_pipeMessagesDropped),
+                       MC_TYPE_WARNING);
+    m_pipeMessagesDropped = 0;
   }
+  if (m_pipeMessages.empty() && (m_stderrLinesDropped > 0))
+  {
+    DoRawConsoleAppend(wxString::Format(_("%li further lines from maxima's stderr "
+                                          "have been dropped."), m_stderrLinesDropped),
+                       MC_TYPE_WARNING);
+    m_stderrLinesDropped = 0;
+  }
+
+  if (!m_pipeMessages.empty())
+    m_maximaStdoutPollTimer.StartOnce(100);
 }
 
 bool wxMaxima::AbortOnError()
@@ -4965,6 +5645,7 @@ bool wxMaxima::AbortOnError()
   }
   if (m_worksheet->m_configuration->GetAbortOnError())
   {
+    FlushCommandsAhead();
     m_worksheet->m_evaluationQueue.Clear();
     // Inform the user that the evaluation queue is empty.
     EvaluationQueueLength(0);
@@ -5137,8 +5818,11 @@ void wxMaxima::OnTimerEvent(wxTimerEvent &event)
         double cpuPercentage = GetMaximaCPUPercentage();
         m_statusBar->SetMaximaCPUPercentage(cpuPercentage);
 
+        // If ReadStdErr() still has messages to display it has already
+        // restarted the timer with a shorter interval.
         if((m_process != NULL) && (m_pid > 0) &&
-           ((cpuPercentage > 0) || (m_maximaBusy)))
+           ((cpuPercentage > 0) || (m_maximaBusy)) &&
+           (!m_maximaStdoutPollTimer.IsRunning()))
           m_maximaStdoutPollTimer.StartOnce(MAXIMAPOLLMSECS);
       }
 
@@ -5160,7 +5844,12 @@ bool wxMaxima::AutoSave()
 {
   if(!SaveNecessary())
     return true;
-  
+
+  // If the last autosave is still being written we try again next time.
+  if(m_autoSaveRunning)
+    return true;
+  WaitForAutoSave();
+
   bool saved;
   wxString oldTempFile = m_tempfileName;
   m_tempfileName = wxStandardPaths::Get().GetTempDir()+
@@ -5171,27 +5860,21 @@ bool wxMaxima::AutoSave()
   if (m_worksheet->m_configuration->AutoSaveAsTempFile() ||
       m_worksheet->m_currentFile.IsEmpty())
   {
-    saved = m_worksheet->ExportToWXMX(m_tempfileName);
-
     wxLogMessage(_("Autosaving as temp file"));
-    if((m_tempfileName != oldTempFile) && saved)
-    {
-      if(!oldTempFile.IsEmpty())
-      {
-        if(wxFileExists(oldTempFile))
-        {
-          SuppressErrorDialogs blocker;
-          wxLogMessage(_("Trying to remove the old temp file"));
-          wxRemoveFile(oldTempFile);
-        }
-      }
-    }
+    if(m_tempfileName != oldTempFile)
+      m_obsoleteTempFile = oldTempFile;
+    saved = AutoSaveInBackground(m_tempfileName, true);
     RegisterAutoSaveFile();
     m_fileSaved = false;
   }
-  else
+  else if (m_worksheet->m_currentFile.Lower().EndsWith(wxT(".wxmx")))
   {
     wxLogMessage(_("Autosaving the .wxmx file"));
+    saved = AutoSaveInBackground(m_worksheet->m_currentFile, false);
+  }
+  else
+  {
+    wxLogMessage(_("Autosaving the .wxm file"));
     saved = SaveFile(false);
   }
   
@@ -5199,6 +5882,84 @@ bool wxMaxima::AutoSave()
   return saved;
 }
 
+bool wxMaxima::AutoSaveInBackground(wxString file, bool tempFile)
+{
+  // Copying the worksheet is fast and needs to be done in the GUI thread.
+  // Writing the copy to the disk can be done while the user continues typing.
+  std::shared_ptr<Worksheet::WXMXSnapshot> snapshot(new Worksheet::WXMXSnapshot);
+  if (!m_worksheet->CreateWXMXSnapshot(file, *snapshot))
+    return false;
+
+  // Changes made after the snapshot has been taken mark the worksheet as
+  // unsaved again.
+  m_worksheet->SetSaved(true);
+  StatusSaveStart();
+  m_autoSaveRunning = true;
+  m_autoSaveThread = std::thread(&wxMaxima::AutoSave_BackgroundTask, this,
+                                 file, tempFile, snapshot);
+  return true;
+}
+
+void wxMaxima::AutoSave_BackgroundTask(wxString file, bool tempFile,
+                                       std::shared_ptr<Worksheet::WXMXSnapshot> snapshot)
+{
+  bool saved = Worksheet::WriteWXMXSnapshot(file, *snapshot);
+  long saveId = snapshot->m_saveId;
+  snapshot.reset();
+
+  wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, autosave_finished_id);
+  event->SetString(file);
+  event->SetPayload(saveId);
+  event->SetInt(saved);
+  event->SetExtraLong(tempFile);
+  m_autoSaveRunning = false;
+  GetEventHandler()->QueueEvent(event);
+}
+
+void wxMaxima::OnAutoSaveFinished(wxThreadEvent &event)
+{
+  WaitForAutoSave();
+
+  wxString file = event.GetString();
+  bool tempFile = (event.GetExtraLong() != 0);
+  m_worksheet->WXMXSaveFinished(file, event.GetPayload<long>(), event.GetInt() != 0);
+  if (event.GetInt())
+  {
+    wxLogMessage(_("wxmx file saved"));
+    StatusSaveFinished();
+    if (tempFile)
+    {
+      // If the worksheet has been saved under a name in the meantime the
+      // temp file is no more needed.
+      if (file != m_tempfileName)
+      {
+        SuppressErrorDialogs blocker;
+        wxRemoveFile(file);
+      }
+      else if ((!m_obsoleteTempFile.IsEmpty()) && wxFileExists(m_obsoleteTempFile))
+      {
+        SuppressErrorDialogs blocker;
+        wxLogMessage(_("Trying to remove the old temp file"));
+        wxRemoveFile(m_obsoleteTempFile);
+      }
+      m_obsoleteTempFile = wxEmptyString;
+    }
+    else
+      RemoveTempAutosavefile();
+  }
+  else
+  {
+    StatusSaveFailed();
+    m_worksheet->SetSaved(false);
+  }
+}
+
+void wxMaxima::WaitForAutoSave()
+{
+  if (m_autoSaveThread.joinable())
+    m_autoSaveThread.join();
+}
+
 void wxMaxima::FileMenu(wxCommandEvent &event)
 {
   if(m_worksheet != NULL)
@@ -8374,6 +9135,26 @@ void wxMaxima::PopupMenu(wxCommandEvent &event)
     }
     break;
   }
+  case TableOfContents::popid_EvalTocChapterSeparately:
+  {
+    GroupCell *SelectionStart = m_worksheet->m_tableOfContents->RightClickedOn();
+    // We only update the table of contents when there is time => no guarantee that the
+    // cell that was clicked at actually still is part of the tree.
+    if ((m_worksheet->GetTree()) && (m_worksheet->GetTree()->Contains(SelectionStart)))
+    {
+      // Each window has its own maxima process => independent parts of the
+      // document can be evaluated in parallel this way.
+      wxString wxm = SelectionStart->ToWXM();
+      GroupCell *tmp = SelectionStart;
+      while ((tmp->m_next != NULL) && (tmp->GetNext()->IsLesserGCType(SelectionStart->GetGroupType())))
+      {
+        tmp = tmp->GetNext();
+        wxm += tmp->ToWXM();
+      }
+      wxGetApp().NewWindow(wxEmptyString, true, false, NULL, 0, wxm);
+    }
+    break;
+  }
   case TableOfContents::popid_ToggleTOCshowsSectionNumbers:
   {
     m_worksheet->m_configuration->TocShowsSectionNumbers(event.IsChecked());
@@ -8886,105 +9667,7 @@ void wxMaxima::EvaluateEvent(wxCommandEvent &WXUNUSED(event))
 
 wxString wxMaxima::GetUnmatchedParenthesisState(wxString text,int &index)
 {
-  text.Trim(true);
-  text.Trim(false);
-  if(text == wxEmptyString)
-    return (wxEmptyString);
-  if (text.EndsWith(wxT("\\")))
-    return (_("Cell ends in a backslash"));
-
-  MaximaTokenizer::TokenList tokens =
-    MaximaTokenizer(text, m_worksheet->m_configuration).GetTokens();
-
-  index = 0;
-  bool endingNeeded = true;
-  wxChar lastnonWhitespace;
-  wxChar lastnonWhitespace_Next = wxT(' ');
-  MaximaTokenizer::TokenList::const_iterator it;
-  std::list<wxChar> delimiters;
-  for (it = tokens.begin(); it != tokens.end(); ++it)
-  {
-    wxString itemText = (*it)->GetText();
-    TextStyle itemStyle = (*it)->GetStyle();
-    index += itemText.Length();
-
-    lastnonWhitespace = lastnonWhitespace_Next;
-
-    // Handle comments
-    if(itemStyle == TS_CODE_COMMENT)
-    {
-      if(!itemText.EndsWith("*/"))
-        return (_("Unterminated comment."));
-      continue;
-    }
-
-    wxChar firstC = itemText[0];
-    wxChar lastC = itemText.Last();
-
-    // Remember the last non-whitespace character that isn't part
-    // of a comment.
-    if((firstC != ' ') && (firstC != '\t') && (firstC != '\r') && (firstC != '\n'))
-      lastnonWhitespace_Next = lastC;
-
-    // Handle opening parenthesis
-    if(itemText == "(")
-    {
-      delimiters.push_back(wxT(')'));
-      continue;
-    }
-    if(itemText == "[")
-    {
-      delimiters.push_back(wxT(']'));
-      continue;
-    }
-    if(itemText == "{")
-    {
-      delimiters.push_back(wxT('}'));
-      continue;
-    }
-
-    // Handle closing parenthesis
-    if((itemText == ')') || (itemText == ']') || (itemText == '}'))
-    {
-      endingNeeded = true;
-      if (delimiters.empty()) return (_("Mismatched parenthesis"));
-      if (firstC != delimiters.back()) return (_("Mismatched parenthesis"));
-      delimiters.pop_back();
-      if (lastnonWhitespace == wxT(','))
-        return (_("Comma directly followed by a closing parenthesis"));
-      continue;
-    }
-
-    if(itemStyle == TS_CODE_STRING)
-    {
-      endingNeeded = true;
-      if(!itemText.EndsWith("\""))
-        return (_("Unterminated string."));
-      continue;
-    }
-
-    if(itemStyle == TS_CODE_ENDOFLINE)
-    {
-      if(!delimiters.empty())
-        return _("Un-closed parenthesis on encountering ; or $");
-      endingNeeded = false;
-      continue;
-    }
-
-    if((*it)->GetStyle() == TS_CODE_LISP)
-    {
-      endingNeeded = false;
-      continue;
-    }
-  }
-
-  if (!delimiters.empty())
-    return _("Un-closed parenthesis");
-
-  if((endingNeeded) && (!m_worksheet->m_configuration->InLispMode()))
-    return _("No dollar ($) or semicolon (;) at the end of command");
-  else
-    return wxEmptyString;
+  return EditorCell::GetUnmatchedParenthesisState(text, m_worksheet->m_configuration, index);
 }
 
 //! Tries to evaluate next group cell in queue
@@ -9076,7 +9759,7 @@ void wxMaxima::TriggerEvaluation()
   if ((text != wxEmptyString) && (text != wxT(";")) && (text != wxT("$")))
   {
     int index;
-    wxString parenthesisError = GetUnmatchedParenthesisState(tmp->GetEditable()->ToString(true),index);
+    wxString parenthesisError = tmp->GetEditable()->GetUnmatchedParenthesisState(index);
     if (parenthesisError == wxEmptyString)
     {
       if (m_worksheet->FollowEvaluation())
@@ -9092,11 +9775,29 @@ void wxMaxima::TriggerEvaluation()
       m_worksheet->m_cellPointers.SetWorkingGroup(tmp);
       tmp->GetPrompt()->SetValue(m_lastPrompt);
 
-      SendMaxima(m_configCommands + text, true);
+      // A command we have sent in advance is already being worked on by maxima.
+      // The configuration commands have to wait until maxima is idle again.
+      if (m_worksheet->m_evaluationQueue.CommandInFlight())
+        StatusMaximaBusy(calculating);
+      else
+      {
+        SendOutputFormat();
+        if ((m_worksheet->m_configuration->PipelineWindow() > 1) && CanBeQueued(tmp, text))
+        {
+          if (m_configCommands != wxEmptyString)
+            SendMaxima(m_configCommands);
+          SendCommandsAhead(tmp, text);
+        }
+        else
+        {
+          SendCellID(tmp);
+          SendMaxima(m_configCommands + text, true);
+        }
+        m_configCommands = wxEmptyString;
+      }
       m_maximaBusy = true;
       // Now that we have sent a command we need to query all variable values anew
       m_varNamesToQuery = m_worksheet->m_variablesPane->GetEscapedVarnames();
-      m_configCommands = wxEmptyString;
 
       EvaluationQueueLength(m_worksheet->m_evaluationQueue.Size(),
                             m_worksheet->m_evaluationQueue.CommandsLeftInCell()
@@ -9152,6 +9853,73 @@ void wxMaxima::TriggerEvaluation()
   }
 }
 
+bool wxMaxima::CanBeQueued(GroupCell *cell, wxString text)
+{
+  text.Trim(true);
+  text.Trim(false);
+  if ((cell == NULL) || (m_worksheet->m_configuration->InLispMode()) ||
+      (text.StartsWith(wxT(":"))) || (text == wxT(";")) || (text == wxT("$")) ||
+      ((!text.EndsWith(wxT(";"))) && (!text.EndsWith(wxT("$")))))
+    return false;
+  int index;
+  return (cell->GetEditable()->GetUnmatchedParenthesisState(index) == wxEmptyString) &&
+    (GetUnmatchedParenthesisState(text, index) == wxEmptyString);
+}
+
+wxString wxMaxima::LispQueueEntry(GroupCell *cell, wxString command)
+{
+  command.Trim(true);
+  command.Trim(false);
+  command = m_worksheet->UnicodeToMaxima(command);
+  AddToHistory(command);
+  StripLispComments(command);
+  AddSymbolsFromCommands(command);
+
+  // The entry has to fit into one line and into a lisp string: wx-enqueue
+  // passes the command to format, which turns ~% into a newline again.
+  command.Replace(wxT("\\"), wxT("\\\\"));
+  command.Replace(wxT("\""), wxT("\\\""));
+  command.Replace(wxT("~"), wxT("~~"));
+  command.Replace(wxT("\r"), wxEmptyString);
+  command.Replace(wxT("\n"), wxT("~%"));
+  return wxString::Format(wxT(" (%li \""), m_worksheet->m_cellPointers.GetCellID(cell)) +
+    command + wxT("\")");
+}
+
+void wxMaxima::SendCommandsAhead(GroupCell *cell, wxString text)
+{
+  EvaluationQueue &queue = m_worksheet->m_evaluationQueue;
+  wxString commands = LispQueueEntry(cell, text);
+  queue.CommandSent(cell);
+
+  while (queue.CommandsInFlight() < (size_t) m_worksheet->m_configuration->PipelineWindow())
+  {
+    wxString next = queue.GetCommand(queue.QueuedCommandsInFlight(), cell);
+    if (!CanBeQueued(cell, next))
+      break;
+    commands += LispQueueEntry(cell, next);
+    queue.CommandSent(cell);
+  }
+
+  // Maxima executes the queued commands one after another without reading its
+  // input in between. If "Abort evaluation on error" is set it skips the rest
+  // of them if one fails.
+  if (m_worksheet->m_configuration->GetAbortOnError())
+    SendMaxima(wxT(":lisp-quiet (wx-enqueue t '(") + commands + wxT("))\n"));
+  else
+    SendMaxima(wxT(":lisp-quiet (wx-enqueue nil '(") + commands + wxT("))\n"));
+}
+
+void wxMaxima::FlushCommandsAhead()
+{
+  // Every command in flight but the one maxima works on might still wait in
+  // maxima's queue. Maxima sends a prompt for each command it drops.
+  // A question maxima asks would read our request as its answer, though.
+  if ((m_worksheet->m_evaluationQueue.CommandsInFlight() > 1) &&
+      (!m_worksheet->m_questionPrompt))
+    SendMaxima(wxT(":lisp-quiet (wx-flush-queue)\n"));
+}
+
 void wxMaxima::InsertMenu(wxCommandEvent &event)
 {
   if(m_worksheet != NULL)
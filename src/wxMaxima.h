@@ -47,6 +47,9 @@
 #include <wx/sckstrm.h>
 #include <wx/buffer.h>
 #include <memory>
+#include <deque>
+#include <thread>
+#include <atomic>
 #ifdef __WXMSW__
 #include <windows.h>
 #endif
@@ -78,6 +81,12 @@
 //! How many miliseconds should we wait between polling for stdout+cpu power?
 #define MAXIMAPOLLMSECS 2000
 
+//! How many bytes to read from maxima's stdout or stderr at once
+#define MAXIMAPIPEBYTES 65536
+
+//! How many messages from maxima's stdout and stderr may wait for being displayed
+#define MAXPIPEMESSAGES 200
+
 #ifndef __WXGTK__
 
 class MyAboutDialog : public wxDialog
@@ -199,6 +208,9 @@ public:
   
   void StripLispComments(wxString &s);
 
+  //! Adds the functions and variables s defines to the autocompletion
+  void AddSymbolsFromCommands(wxString s);
+
   void SendMaxima(wxString s, bool addToHistory = false);
 
   //! Open a file
@@ -416,6 +428,38 @@ protected:
      as well.
   */
   void TryToReadDataFromMaxima();
+
+  //! What we do with maxima's output if it got too long, see OnOutputOverflow()
+  enum OutputOverflowMode
+  {
+    overflow_none,     //!< The output is interpreted as usual
+    overflow_paused,   //!< We don't read from maxima until the user has decided
+    overflow_discard,  //!< The output is dropped until the next prompt
+    overflow_truncate, //!< Like overflow_discard, but the worksheet tells that output is missing
+    overflow_file      //!< The output is written to m_outputOverflowFile until the next prompt
+  };
+  /*! Called if maxima's output that cannot be interpreted yet exceeds MaxUnparsedOutput()
+
+    Asks the user if the rest of this output is to be discarded, truncated or
+    written to a file. While the question is open we don't read from maxima
+    so maxima has to wait until the socket's buffer has room again.
+    In batch mode the output is truncated without asking.
+   */
+  void OnOutputOverflow();
+  /*! Asks the user what OnOutputOverflow() shall do with the rest of the output
+
+    If the output is to be written to a file this function opens it.
+   */
+  OutputOverflowMode AskForOutputOverflowMode();
+  /*! Disposes of the output maxima sends until the next prompt
+
+    \return
+      - true, if we still are waiting for the prompt
+      - false, if the prompt has arrived: m_newCharsFromMaxima now begins with it.
+   */
+  bool SinkOverflowingOutput();
+  //! Leaves the state OnOutputOverflow() has entered
+  void EndOutputOverflow();
     
   //! Triggered when we get new chars from maxima.
   void OnNewChars();
@@ -475,6 +519,28 @@ protected:
   //! Try to evaluate the next command for maxima that is in the evaluation queue
   void TriggerEvaluation();
 
+  /*! Send a command and the ones that follow it in the evaluation queue to maxima
+
+    The commands are placed in a queue on the lisp side (see wx-enqueue in
+    wxMathML.lisp) that maxima works through without waiting for us to
+    interpret its output in between. Questions maxima asks meanwhile still are
+    answered from maxima's input, not by the next command. How many commands
+    are sent in one go is set by Configuration::PipelineWindow().
+    \param cell The cell the command belongs to
+    \param text The command, which has to fulfill CanBeQueued()
+   */
+  void SendCommandsAhead(GroupCell *cell, wxString text);
+  /*! Make maxima drop the commands SendCommandsAhead() has sent that it hasn't started yet
+
+    Maxima keeps running them after errors wxMaxima detects (see AbortOnError())
+    and after being interrupted, otherwise.
+   */
+  void FlushCommandsAhead();
+  //! Can text be sent to maxima using SendCommandsAhead()?
+  bool CanBeQueued(GroupCell *cell, wxString text);
+  //! The representation of a command in the list wx-enqueue gets
+  wxString LispQueueEntry(GroupCell *cell, wxString command);
+
   void TryUpdateInspector();
 
   void UpdateDrawPane();
@@ -495,6 +561,22 @@ protected:
    */
   bool StartMaxima(bool force = false);
 
+  /*! Starts maxima processes in the background until Configuration::MaximaPoolSize() are ready
+
+    Each of them gets a server of its own it connects to; The connection is
+    only accepted when StartMaxima() takes the process over.
+   */
+  void StartSpareMaximas();
+  /*! Makes a spare maxima the current maxima process
+
+    \param command The command the new maxima would have been started with
+    \return false if no spare maxima matching command and the current
+    working directory was available.
+   */
+  bool UseSpareMaxima(const wxString &command);
+  //! Kills all spare maxima processes
+  void KillSpareMaximas();
+
   void OnClose(wxCloseEvent &event);               //!< close wxMaxima window
   wxString GetCommand(bool params = true);         //!< returns the command to start maxima
   //    (uses guessConfiguration)
@@ -502,6 +584,35 @@ protected:
   //! Polls the stderr and stdout of maxima for input.
   void ReadStdErr();
 
+  /*! Reads everything that is available from one of maxima's pipes without blocking
+
+    Reads at most MAXIMAPIPEBYTES per call; anything beyond that is read the
+    next time.
+    \param stream The stream to read from
+    \param pending The bytes at the end of the last read that didn't form a
+    complete UTF-8 character, yet.
+    \param isError true = stream is maxima's stderr
+   */
+  void ReadPipe(wxInputStream *stream, wxMemoryBuffer &pending, bool isError);
+
+  /*! Queues a message from maxima's stdout or stderr for being displayed
+
+    Runs of identical lines and messages that repeat the last one are
+    collapsed into one. If MAXPIPEMESSAGES messages are already waiting the
+    message is dropped and only counted.
+
+    If the message is an error message evaluation is aborted now: By the
+    time it is displayed another cell might be the one maxima works on.
+   */
+  void QueuePipeMessage(wxString text, bool isError);
+
+  /*! Displays the queued messages from maxima's stdout and stderr
+
+    If there are more messages than can be displayed in a few milliseconds the
+    rest is displayed the next time the stdout poll timer expires.
+   */
+  void DisplayPipeMessages();
+
   /*! Determines the process id of maxima from its initial output
 
     This function does several things:
@@ -547,6 +658,24 @@ protected:
    */
   void ReadStatusBar(wxString &data);
 
+  /*! Reads the number of the cell the following output is for
+
+    Before each command we send to maxima we tell it the number
+    CellPointers::GetCellID() has assigned to the command's cell and maxima
+    echoes it as soon as it starts working on the command. All output until
+    the next of these numbers is therefore routed to that cell.
+   */
+  void ReadCellID(wxString &data);
+
+  //! Tell maxima which cell the command we will send next belongs to
+  void SendCellID(GroupCell *cell);
+
+  /*! Tell maxima if to send its 2D output as XML or in the compact format
+
+    Only sends something if the format has changed since the last call.
+   */
+  void SendOutputFormat();
+
   /*! Reads the math cell's contents from Maxima.
      
      Math cells are enclosed between the tags \<mth\> and \</mth\>. 
@@ -666,6 +795,21 @@ protected:
     Returns false if a save was necessary, but not possible.
    */
   bool AutoSave();
+
+  /*! Saves a snapshot of the worksheet to a .wxmx file in a background thread
+
+    \param file The file to save to
+    \param tempFile true = file is the temp file that is used if the user hasn't
+                    saved the worksheet under a name, yet.
+   */
+  bool AutoSaveInBackground(wxString file, bool tempFile);
+  //! The part of AutoSaveInBackground() that runs in the background thread
+  void AutoSave_BackgroundTask(wxString file, bool tempFile,
+                               std::shared_ptr<Worksheet::WXMXSnapshot> snapshot);
+  //! Called when the background thread has finished saving the file
+  void OnAutoSaveFinished(wxThreadEvent &event);
+  //! Waits until a running background save has finished
+  void WaitForAutoSave();
   
   int SaveDocumentP();
 
@@ -687,9 +831,65 @@ protected:
   wxInputStream *m_maximaStdout;
   //! The stderr of the maxima process
   wxInputStream *m_maximaStderr;
+  //! The last bytes read from maxima's stdout, if they didn't form a complete character
+  wxMemoryBuffer m_stdoutBytes;
+  //! The last bytes read from maxima's stderr, if they didn't form a complete character
+  wxMemoryBuffer m_stderrBytes;
+  //! A message from maxima's stdout or stderr that waits for being displayed
+  struct PipeMessage
+  {
+    wxString text;
+    //! true = the message is from maxima's stderr
+    bool isError;
+    //! true = the message has been recognized as an error message
+    bool showAsError;
+    //! How many times the message has been repeated
+    long repeats;
+  };
+  //! The messages from maxima's stdout and stderr that wait for being displayed
+  std::deque<PipeMessage> m_pipeMessages;
+  //! How many messages from maxima's stdout have been dropped since m_pipeMessages was full
+  long m_pipeMessagesDropped;
+  //! How many lines from maxima's stderr have been dropped since m_pipeMessages was full
+  long m_stderrLinesDropped;
   int m_port;
+  //! A maxima process that has been started in advance, see StartSpareMaximas()
+  struct SpareMaxima
+  {
+    wxProcess *process;
+    //! The server only this process connects to
+    wxSocketServer *server;
+    int port;
+    //! The command the process was started with, without the "-s port"
+    wxString command;
+    //! The MAXIMA_INITIAL_FOLDER the process was started with
+    wxString initialFolder;
+  };
+  //! The maxima processes that wait for a restart of this window's maxima
+  std::list<SpareMaxima> m_spareMaximas;
+  //! true = maxima has been told to send its output in the compact format
+  bool m_compactOutput;
+  /*! true = the output until the next cell-id or prompt belongs to no cell
+
+    This is the case for the output of a cell that has been deleted or has
+    left the evaluation queue after its command has been sent to maxima.
+   */
+  bool m_discardCellOutput;
+  //! The folder the current maxima has been told to start in
+  wxString m_maximaInitialFolder;
+  //! Kills a spare maxima and closes its server
+  void KillSpareMaxima(const SpareMaxima &spare);
   //! All chars from maxima that still aren't part of m_currentOutput
   wxString m_newCharsFromMaxima;
+  OutputOverflowMode m_outputOverflowMode;
+  //! The file the output goes to in the mode overflow_file
+  std::unique_ptr<wxFileOutputStream> m_outputOverflowFile;
+  //! The name of m_outputOverflowFile
+  wxString m_outputOverflowFileName;
+  //! The last chars we have sunk might be the start of the prompt prefix
+  wxString m_outputOverflowTail;
+  //! How many chars of output we have disposed of since the output got too long
+  long m_outputOverflowChars;
   /*! The end of maxima's current uninterpreted output, see m_currentOutput.
    
     If we just want to look if maxima's current output contains an ending tag
@@ -737,6 +937,12 @@ protected:
   //! The directory with maxima's documentation
   wxString m_maximaDocDir;
   bool m_fileSaved;
+  //! The thread autosaves are written in
+  std::thread m_autoSaveThread;
+  //! Is an autosave currently being written in the background?
+  std::atomic<bool> m_autoSaveRunning;
+  //! The temp file that can be deleted as soon as the current autosave has succeeded
+  wxString m_obsoleteTempFile;
   wxString m_chmhelpFile;
   wxString m_maximaVersion;
   wxString m_maximaArch;
@@ -803,8 +1009,10 @@ public:
     \param file The file name
     \param evalOnStartup Do we want to execute the file automatically, but halt on error?
     \param exitAfterEval Do we want to close the window after the file has been evaluated?
+    \param wxmContents The uncompressed .wxm code to populate the worksheet with
    */
-  void NewWindow(wxString file = wxEmptyString, bool evalOnStartup = false, bool exitAfterEval = false, unsigned char *wxmData = NULL, int wxmLen = 0);
+  void NewWindow(wxString file = wxEmptyString, bool evalOnStartup = false, bool exitAfterEval = false, unsigned char *wxmData = NULL, int wxmLen = 0,
+                 const wxString &wxmContents = wxEmptyString);
 
   void NewTutorialWindow(wxString contents);
 
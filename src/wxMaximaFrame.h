@@ -486,7 +486,8 @@ public:
     gnuplot_process_id,
     menu_additionalSymbols,
     menu_showLatinGreekLookalikes,
-    menu_showGreekMu
+    menu_showGreekMu,
+    autosave_finished_id
   };
 
   /*! Update the recent documents list